@@ -0,0 +1,235 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * AVR cycle benchmark for bibase.
+ *
+ *  Converts the same 16 and 32-bit values to decimal four ways and reports
+ *  the worst and mean cycle count of each, measured with timer 1 at clk/1:
+ *
+ *      bibase  - the bibase_mp assembler kernel
+ *      div10   - repeated / 10 and % 10 through the libgcc divide
+ *      recip   - divide by 10 as a multiply by the fixed-point reciprocal
+ *      nibble  - add flash table decimal weights of each nibble, then carry
+ *
+ *  Results go out polled on the console USART, 9600 8N2.
+ *
+ *      make -C bench
+ *      avrdude -p atmega328p -U bench/avr-bibase-bench
+ */
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/setbaud.h>
+
+#include "bibase.h"
+
+#define SAMPLES 64
+
+typedef uint8_t (* convert_t)(uint32_t v, uint8_t * const str);
+
+static void uart_putc(char c)
+{
+    while (!(UCSR0A & _BV(UDRE0)));
+    UDR0 = c;
+}
+
+static void uart_puts_P(PGM_P s)
+{
+    char c;
+
+    while ((c = pgm_read_byte(s++)))
+    {
+        uart_putc(c);
+    }
+}
+
+static void uart_putu(uint32_t v)
+{
+    uint8_t str[10];
+    uint8_t n = bibase32(v, str, 256 - 10);
+
+    if (0 == n)
+    {
+        uart_putc('0');
+    }
+
+    while (n)
+    {
+        uart_putc('0' + str[--n]);
+    }
+}
+
+static uint8_t conv_bibase16(uint32_t v, uint8_t * const str)
+{
+    return bibase16(v, str, 256 - 10);
+}
+
+static uint8_t conv_bibase32(uint32_t v, uint8_t * const str)
+{
+    return bibase32(v, str, 256 - 10);
+}
+
+static uint8_t conv_div10(uint32_t v, uint8_t * const str)
+{
+    uint8_t n = 0;
+
+    while (v)
+    {
+        str[n++] = v % 10;
+        v /= 10;
+    }
+
+    return n;
+}
+
+static uint8_t conv_recip(uint32_t v, uint8_t * const str)
+{
+    uint8_t n = 0;
+
+    /* 0xCCCCCCCD / 2^35 is 1/10 exact over the 32-bit range */
+    while (v)
+    {
+        uint32_t const q = ((uint64_t) v * 0xCCCCCCCDUL) >> 35;
+
+        str[n++] = v - q * 10;
+        v = q;
+    }
+
+    return n;
+}
+
+/*
+ * Decimal digits of n * 16^k for each nibble position k, least significant
+ * digit first, ten digits each.  Folded by the compiler into flash, the
+ * table is 1280 bytes, more than half the RAM.
+ */
+#define NIBBLE_DIGIT(k, n, p) ((((uint32_t) (n) << (4 * (k))) / (p)) % 10)
+
+#define NIBBLE_WEIGHT(k, n)                                                    \
+    { NIBBLE_DIGIT(k, n, 1UL),         NIBBLE_DIGIT(k, n, 10UL),               \
+      NIBBLE_DIGIT(k, n, 100UL),       NIBBLE_DIGIT(k, n, 1000UL),             \
+      NIBBLE_DIGIT(k, n, 10000UL),     NIBBLE_DIGIT(k, n, 100000UL),           \
+      NIBBLE_DIGIT(k, n, 1000000UL),   NIBBLE_DIGIT(k, n, 10000000UL),         \
+      NIBBLE_DIGIT(k, n, 100000000UL), NIBBLE_DIGIT(k, n, 1000000000UL) }
+
+#define NIBBLE_WEIGHTS(k)                                                      \
+    { NIBBLE_WEIGHT(k, 0),  NIBBLE_WEIGHT(k, 1),  NIBBLE_WEIGHT(k, 2),         \
+      NIBBLE_WEIGHT(k, 3),  NIBBLE_WEIGHT(k, 4),  NIBBLE_WEIGHT(k, 5),         \
+      NIBBLE_WEIGHT(k, 6),  NIBBLE_WEIGHT(k, 7),  NIBBLE_WEIGHT(k, 8),         \
+      NIBBLE_WEIGHT(k, 9),  NIBBLE_WEIGHT(k, 10), NIBBLE_WEIGHT(k, 11),        \
+      NIBBLE_WEIGHT(k, 12), NIBBLE_WEIGHT(k, 13), NIBBLE_WEIGHT(k, 14),        \
+      NIBBLE_WEIGHT(k, 15) }
+
+static uint8_t const nibble_table[8][16][10] PROGMEM = {
+    NIBBLE_WEIGHTS(0), NIBBLE_WEIGHTS(1), NIBBLE_WEIGHTS(2), NIBBLE_WEIGHTS(3),
+    NIBBLE_WEIGHTS(4), NIBBLE_WEIGHTS(5), NIBBLE_WEIGHTS(6), NIBBLE_WEIGHTS(7)
+};
+
+static uint8_t conv_nibble(uint32_t v, uint8_t * const str)
+{
+    uint8_t n = 0;
+
+    memset(str, 0, 10);
+
+    for (uint8_t k = 0; v; k++, v >>= 4)
+    {
+        uint8_t const * const w = nibble_table[k][v & 0x0F];
+
+        for (uint8_t i = 0; i < 10; i++)
+        {
+            str[i] += pgm_read_byte(&w[i]);
+        }
+    }
+
+    for (uint8_t i = 0, carry = 0; i < 10; i++)
+    {
+        str[i] += carry;
+        carry = 0;
+
+        while (str[i] >= 10)
+        {
+            str[i] -= 10;
+            carry++;
+        }
+
+        if (str[i] || carry)
+        {
+            n = i + 1;
+        }
+    }
+
+    return n;
+}
+
+static void bench(PGM_P name, convert_t convert, uint32_t mask)
+{
+    uint8_t str[10];
+    uint16_t worst = 0;
+    uint32_t total = 0;
+    uint32_t v = 0xFFFFFFFFUL;
+
+    for (uint8_t i = 0; i < SAMPLES; i++)
+    {
+        uint16_t start, cycles;
+
+        TCNT1 = 0;
+        start = TCNT1;
+        convert(v & mask, str);
+        cycles = TCNT1 - start;
+
+        if (cycles > worst) worst = cycles;
+        total += cycles;
+
+        /* all ones first, then a spread of values */
+        v = v * 1103515245UL + 12345;
+    }
+
+    uart_puts_P(name);
+    uart_puts_P(PSTR(" worst "));
+    uart_putu(worst);
+    uart_puts_P(PSTR(" mean "));
+    uart_putu(total / SAMPLES);
+    uart_puts_P(PSTR("\r\n"));
+}
+
+int main(void)
+{
+    UBRR0 = UBRR_VALUE;
+    UCSR0A = USE_2X ? _BV(U2X0) : 0;
+    UCSR0C = _BV(UCSZ00) | _BV(UCSZ01) | _BV(USBS0);
+    UCSR0B = _BV(TXEN0);
+
+    /* timer 1 free running at clk/1, one count per cycle */
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    uart_puts_P(PSTR("16-bit\r\n"));
+    bench(PSTR("  bibase"), conv_bibase16, 0xFFFFUL);
+    bench(PSTR("  div10 "), conv_div10, 0xFFFFUL);
+    bench(PSTR("  recip "), conv_recip, 0xFFFFUL);
+    bench(PSTR("  nibble"), conv_nibble, 0xFFFFUL);
+
+    uart_puts_P(PSTR("32-bit\r\n"));
+    bench(PSTR("  bibase"), conv_bibase32, 0xFFFFFFFFUL);
+    bench(PSTR("  div10 "), conv_div10, 0xFFFFFFFFUL);
+    bench(PSTR("  recip "), conv_recip, 0xFFFFFFFFUL);
+    bench(PSTR("  nibble"), conv_nibble, 0xFFFFFFFFUL);
+
+    for (;;);
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * AVR cycle benchmark for console output.
+ *
+ *  Queues a 64-byte line three ways and reports the cycles spent in the call,
+ *  measured with timer 1 at clk/1:
+ *
+ *      write   - console_write(), one critical section per contiguous copy
+ *      putchar - console_putchar() once per byte
+ *      fputs   - fputs() through the avr-libc FILE put function
+ *
+ *  The line is queued in chunks that fit the free transmit ring-buffer, and
+ *  the ring-buffer drains between chunks, so no call blocks waiting for the
+ *  line and only the cost of queueing is counted.  Transmit interrupts taken
+ *  during a call are included.
+ *
+ *  Then reports the cycles per byte sent by the transmit data register empty
+ *  interrupt, through each of its paths:
+ *
+ *      text    - printable text, udre_fast only
+ *      newline - NL with ONLCR, CR from udre_fast and NL from udre_slow
+ *      frame   - a binary frame, udre_slow only
+ *
+ *  The handler is called from the bench with its interrupt masked, once the
+ *  data register is empty.  The call and return cost within a few cycles of
+ *  the hardware entry.  Build one application per TX_BUF_SIZE:
+ *
+ *      make -C bench
+ *      avrdude -p atmega328p -U bench/avr-console-bench-32
+ */
+#include "project.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+#include "timer.h"
+#include "console.h"
+
+#define LINE_SIZE 64
+#define SAMPLES 8
+
+/* drain time for a chunk, 70 ms covers 64 bytes at 9600 8N2 */
+#define DRAIN_TICKS ((tbtick_st) TBTICKS_FROM_MS(70))
+
+#define CHUNK_SIZE (((TX_BUF_SIZE - 1) < LINE_SIZE) ? (TX_BUF_SIZE - 1)        \
+                                                     : LINE_SIZE)
+
+#define UDRE_TEXT    (0)
+#define UDRE_NEWLINE (1)
+#define UDRE_FRAME   (2)
+
+static char line[LINE_SIZE + 1];
+static char newlines[LINE_SIZE];
+
+extern void USART_UDRE_vect(void);
+
+static uint16_t time_write(char const * s, uint8_t n)
+{
+    uint16_t start;
+
+    start = TCNT1;
+    console_write(s, n);
+
+    return TCNT1 - start;
+}
+
+static uint16_t time_putchar(char const * s, uint8_t n)
+{
+    uint16_t start;
+
+    start = TCNT1;
+    while (n--)
+    {
+        console_putchar(*s++, stdout);
+    }
+
+    return TCNT1 - start;
+}
+
+static uint16_t time_fputs(char const * s, uint8_t n)
+{
+    char chunk[CHUNK_SIZE + 1];
+    uint16_t start;
+
+    memcpy(chunk, s, n);
+    chunk[n] = '\0';
+
+    start = TCNT1;
+    fputs(chunk, stdout);
+
+    return TCNT1 - start;
+}
+
+static uint32_t time_line(uint16_t (* queue)(char const * s, uint8_t n))
+{
+    uint32_t cycles = 0;
+
+    for (uint8_t i = 0; i < LINE_SIZE; i += CHUNK_SIZE)
+    {
+        uint8_t const n = ((LINE_SIZE - i) < CHUNK_SIZE) ? (LINE_SIZE - i)
+                                                         : CHUNK_SIZE;
+
+        cycles += queue(&line[i], n);
+        timer_delay(DRAIN_TICKS);
+    }
+
+    return cycles;
+}
+
+static void bench(PGM_P name, uint16_t (* queue)(char const * s, uint8_t n))
+{
+    uint32_t total = 0;
+
+    for (uint8_t i = 0; i < SAMPLES; i++)
+    {
+        total += time_line(queue);
+    }
+
+    printf_P(PSTR("\n%S %lu cycles per line\n"), name, total / SAMPLES);
+    timer_delay(DRAIN_TICKS);
+}
+
+/*
+ * Queue one chunk for the transmit interrupt, with interrupts disabled.
+ */
+static void udre_queue(uint8_t what)
+{
+    if (what == UDRE_FRAME)
+    {
+        console_frame((uint8_t const *) line, CHUNK_SIZE);
+    }
+    else
+    {
+        console_trywrite((what == UDRE_TEXT) ? line : newlines, CHUNK_SIZE);
+    }
+}
+
+static void bench_udre(PGM_P name, uint8_t what)
+{
+    uint32_t total = 0;
+    uint16_t bytes = 0;
+
+    for (uint8_t i = 0; i < SAMPLES; i++)
+    {
+        cli();
+        udre_queue(what);
+
+        while (UCSR0B & _BV(UDRIE0))
+        {
+            uint16_t start;
+
+            /* wait for the data register with only this interrupt masked */
+            UCSR0B &= ~_BV(UDRIE0);
+            sei();
+            while (!(UCSR0A & _BV(UDRE0)));
+            cli();
+            UCSR0B |= _BV(UDRIE0);
+
+            /* the handler returns with reti, the cli runs before any other */
+            start = TCNT1;
+            USART_UDRE_vect();
+            cli();
+            total += TCNT1 - start;
+            bytes++;
+        }
+
+        sei();
+        timer_delay(DRAIN_TICKS);
+    }
+
+    printf_P(PSTR("\n%S %lu cycles per byte\n"), name, total / bytes);
+    timer_delay(DRAIN_TICKS);
+}
+
+void main(void)
+{
+    ATOMIC_BLOCK(ATOMIC_FORCEON)
+    {
+        tbtick_init();
+        console_init();
+    }
+
+    /* timer 1 free running at clk/1, one count per cycle */
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    /* printable line without a newline, so ONLCR does not add a byte */
+    for (uint8_t i = 0; i < LINE_SIZE; i++)
+    {
+        line[i] = 'A' + (i % 26);
+        newlines[i] = '\n';
+    }
+
+    printf_P(PSTR("\nTX_BUF_SIZE %u, %u byte chunks\n"), TX_BUF_SIZE,
+             CHUNK_SIZE);
+
+    bench(PSTR("write  "), time_write);
+    bench(PSTR("putchar"), time_putchar);
+    bench(PSTR("fputs  "), time_fputs);
+
+    bench_udre(PSTR("text   "), UDRE_TEXT);
+    bench_udre(PSTR("newline"), UDRE_NEWLINE);
+    bench_udre(PSTR("frame  "), UDRE_FRAME);
+
+    for (;;);
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * AVR cycle and size benchmark for formatted output, fmt_line against
+ * printf_P.
+ *
+ *  Formats the pid status line of main.c for a spread of values and reports
+ *  the worst and mean cycles per line, measured with timer 1 at clk/1.  Both
+ *  write into the same RAM sink in place of the console, so only formatting
+ *  is counted.  One application is built per formatter, FMT_BENCH selects:
+ *
+ *      FMT_BENCH_FMT    - fmt_line, fmt.c and the bibase kernel
+ *      FMT_BENCH_PRINTF - printf_P, the default avr-libc vfprintf
+ *
+ *  so the flash and RAM each formatter costs is the difference between the
+ *  two, make size reports them.  The formatted line goes out after the
+ *  counts so the two can be compared.  Results go out polled on the console
+ *  USART, 9600 8N2.
+ *
+ *      make -C bench size
+ *      avrdude -p atmega328p -U bench/avr-fmt-bench-fmt
+ *      avrdude -p atmega328p -U bench/avr-fmt-bench-printf
+ */
+#include "project.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/setbaud.h>
+
+#include "bibase.h"
+
+#define FMT_BENCH_FMT    (1)
+#define FMT_BENCH_PRINTF (2)
+
+#ifndef FMT_BENCH
+#define FMT_BENCH FMT_BENCH_FMT
+#endif
+
+#if FMT_BENCH == FMT_BENCH_FMT
+#include "fmt.h"
+#endif
+
+#define SINK_SIZE (96)
+
+static char sink[SINK_SIZE];
+static uint8_t sink_len;
+
+static uint16_t const values[] PROGMEM =
+{
+    0, 7, 42, 511, 1500, 2400, 9999, 65535,
+};
+
+static void uart_putc(char c)
+{
+    while (!(UCSR0A & _BV(UDRE0)));
+    UDR0 = c;
+}
+
+static void uart_puts_P(PGM_P s)
+{
+    char c;
+
+    while ((c = pgm_read_byte(s++)))
+    {
+        uart_putc(c);
+    }
+}
+
+static void uart_putu(uint32_t v)
+{
+    uint8_t str[10];
+    uint8_t n = bibase32(v, str, 256 - 10);
+
+    if (0 == n)
+    {
+        uart_putc('0');
+    }
+
+    while (n)
+    {
+        uart_putc('0' + str[--n]);
+    }
+}
+
+#if FMT_BENCH == FMT_BENCH_FMT
+/*
+ * fmt.c output, the sink stands in for the console and the log.
+ */
+int console_write(void const * buf, size_t len)
+{
+    if (len > sizeof(sink) - sink_len) len = sizeof(sink) - sink_len;
+
+    memcpy(&sink[sink_len], buf, len);
+    sink_len += len;
+
+    return 0;
+}
+
+int8_t log_write(uint8_t level, void const * msg, uint8_t len)
+{
+    (void) level;
+
+    return console_write(msg, len);
+}
+
+static void format(uint8_t on, uint16_t feedback, uint16_t output)
+{
+    fmt_line(FMT_S("pid "), FMT_STR(on ? "on" : "off"),
+             FMT_S(", feedback "), FMT_U(feedback),
+             FMT_S(", output "), FMT_U(output),
+             FMT_S(" us\n"));
+}
+#else
+static int sink_putchar(char c, FILE * stream)
+{
+    (void) stream;
+
+    if (sink_len < sizeof(sink)) sink[sink_len++] = c;
+
+    return 0;
+}
+
+static FILE sink_file = FDEV_SETUP_STREAM(sink_putchar, NULL,
+                                          _FDEV_SETUP_WRITE);
+
+static void format(uint8_t on, uint16_t feedback, uint16_t output)
+{
+    printf_P(PSTR("pid %s, feedback %u, output %u us\n"), on ? "on" : "off",
+             feedback, output);
+}
+#endif
+
+void main(void)
+{
+    uint16_t worst = 0;
+    uint32_t total = 0;
+    uint8_t i;
+
+    UBRR0 = UBRR_VALUE;
+    UCSR0A = USE_2X ? _BV(U2X0) : 0;
+    UCSR0C = _BV(UCSZ00) | _BV(UCSZ01) | _BV(USBS0);
+    UCSR0B = _BV(TXEN0);
+
+#if FMT_BENCH == FMT_BENCH_PRINTF
+    stdout = &sink_file;
+#endif
+
+    /* timer 1 free running at clk/1, one count per cycle */
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    for (i = 0; i < 2 * ARRAY_SIZE(values); i++)
+    {
+        uint16_t const v = pgm_read_word(&values[i % ARRAY_SIZE(values)]);
+        uint16_t start, cycles;
+
+        sink_len = 0;
+
+        start = TCNT1;
+        format(i & 1, v, 65535 - v);
+        cycles = TCNT1 - start;
+
+        if (cycles > worst) worst = cycles;
+        total += cycles;
+    }
+
+#if FMT_BENCH == FMT_BENCH_FMT
+    uart_puts_P(PSTR("fmt_line worst "));
+#else
+    uart_puts_P(PSTR("printf_P worst "));
+#endif
+    uart_putu(worst);
+    uart_puts_P(PSTR(" mean "));
+    uart_putu(total / (2 * ARRAY_SIZE(values)));
+    uart_puts_P(PSTR("\r\n"));
+
+    for (i = 0; i < sink_len; i++)
+    {
+        if (sink[i] == '\n') uart_putc('\r');
+        uart_putc(sink[i]);
+    }
+
+    for (;;);
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * AVR cycle benchmark for the ring-buffers, struct ring_buffer against the
+ * power-of-two struct ring_buffer8.
+ *
+ *  Times each call on both variants with timer 1 at clk/1 and reports the
+ *  worst and mean cycles, less the cost of reading the timer:
+ *
+ *      put put_echo echo get unput erase kill count
+ *
+ *  Each call is made PASSES times on a RING_SIZE byte ring-buffer held half
+ *  full.  The cursors move on four positions a pass, so they pass every
+ *  position and the wrap is included.  The
+ *  ring-buffer is set up before and restored after each call untimed.  The
+ *  call overhead is the same for both variants.
+ *
+ *  Results go out polled on the console USART, 9600 8N2.
+ *
+ *      make -C bench
+ *      avrdude -p atmega328p -U bench/avr-rb-bench
+ */
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/setbaud.h>
+
+#include "bibase.h"
+#include "librb.h"
+
+#define RING_SIZE (32)
+#define PASSES    (128)
+
+struct result
+{
+    uint16_t worst;
+    uint32_t total;
+};
+
+enum
+{
+    OP_PUT,
+    OP_PUT_ECHO,
+    OP_ECHO,
+    OP_GET,
+    OP_UNPUT,
+    OP_ERASE,
+    OP_KILL,
+    OP_COUNT,
+    OPS
+};
+
+static char const op_names[OPS][9] PROGMEM =
+{
+    "put     ", "put_echo", "echo    ", "get     ",
+    "unput   ", "erase   ", "kill    ", "count   ",
+};
+
+static uint8_t buffer[RING_SIZE];
+static uint8_t buffer8[RING_SIZE];
+static struct ring_buffer rb;
+static struct ring_buffer8 rb8;
+
+static struct result results[2][OPS];
+
+/* cycles spent reading the timer, taken off each sample */
+static uint16_t overhead;
+
+static void uart_putc(char c)
+{
+    while (!(UCSR0A & _BV(UDRE0)));
+    UDR0 = c;
+}
+
+static void uart_puts_P(PGM_P s)
+{
+    char c;
+
+    while ((c = pgm_read_byte(s++)))
+    {
+        uart_putc(c);
+    }
+}
+
+static void uart_putu(uint32_t v)
+{
+    uint8_t str[10];
+    uint8_t n = bibase32(v, str, 256 - 10);
+
+    if (0 == n)
+    {
+        uart_putc('0');
+    }
+
+    while (n)
+    {
+        uart_putc('0' + str[--n]);
+    }
+}
+
+static void record(struct result * const r, uint16_t cycles)
+{
+    cycles -= overhead;
+
+    if (cycles > r->worst) r->worst = cycles;
+    r->total += cycles;
+}
+
+/*
+ * Time one statement into results[v][op].
+ */
+#define TIMED(v, op, stmt) do                                                  \
+{                                                                              \
+    uint16_t const _start = TCNT1;                                             \
+    stmt;                                                                      \
+    record(&results[v][op], TCNT1 - _start);                                   \
+} while (0)
+
+/*
+ * One pass over every call of a variant, pfx is rb or rb8 and kill_t the type
+ * of a kill position.
+ */
+#define RB_BENCH(name, v, ring_t, pfx, kill_t)                                 \
+static void name(ring_t * const r)                                             \
+{                                                                              \
+    uint8_t b = 0x55;                                                          \
+    uint8_t i;                                                                 \
+                                                                               \
+    for (i = 0; i < RING_SIZE / 2; i++) pfx##_put(r, &b);                      \
+                                                                               \
+    for (i = 0; i < PASSES; i++)                                               \
+    {                                                                          \
+        kill_t p;                                                              \
+                                                                               \
+        TIMED(v, OP_PUT, pfx##_put(r, &b));                                    \
+        pfx##_get(r, &b);                                                      \
+                                                                               \
+        TIMED(v, OP_PUT_ECHO, pfx##_put_echo(r, &b));                          \
+        TIMED(v, OP_ECHO, pfx##_echo(r, &b));                                  \
+        TIMED(v, OP_GET, pfx##_get(r, &b));                                    \
+                                                                               \
+        pfx##_put(r, &b);                                                      \
+        TIMED(v, OP_UNPUT, pfx##_unput(r, &b));                                \
+                                                                               \
+        pfx##_put_echo(r, &b);                                                 \
+        pfx##_echo(r, &b);                                                     \
+        TIMED(v, OP_ERASE, pfx##_erase(r));                                    \
+                                                                               \
+        p = r->put;                                                            \
+        pfx##_put_echo(r, &b);                                                 \
+        pfx##_put_echo(r, &b);                                                 \
+        pfx##_echo(r, &b);                                                     \
+        TIMED(v, OP_KILL, pfx##_kill(r, p));                                   \
+                                                                               \
+        TIMED(v, OP_COUNT, pfx##_count(r));                                    \
+                                                                               \
+        pfx##_put(r, &b);                                                      \
+        pfx##_put(r, &b);                                                      \
+        pfx##_get(r, &b);                                                      \
+        pfx##_get(r, &b);                                                      \
+    }                                                                          \
+}
+
+RB_BENCH(bench_rb, 0, struct ring_buffer, rb, uint8_t *)
+RB_BENCH(bench_rb8, 1, struct ring_buffer8, rb8, uint8_t)
+
+int main(void)
+{
+    uint8_t op;
+    uint8_t v;
+
+    UBRR0 = UBRR_VALUE;
+    UCSR0A = USE_2X ? _BV(U2X0) : 0;
+    UCSR0C = _BV(UCSZ00) | _BV(UCSZ01) | _BV(USBS0);
+    UCSR0B = _BV(TXEN0);
+
+    /* timer 1 free running at clk/1, one count per cycle */
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    {
+        uint16_t const start = TCNT1;
+        overhead = TCNT1 - start;
+    }
+
+    rb_init(&rb, buffer, sizeof(buffer));
+    rb8_init(&rb8, buffer8, sizeof(buffer8));
+
+    bench_rb(&rb);
+    bench_rb8(&rb8);
+
+    uart_puts_P(PSTR("op        rb worst mean  rb8 worst mean\r\n"));
+
+    for (op = 0; op < OPS; op++)
+    {
+        uart_puts_P(op_names[op]);
+
+        for (v = 0; v < 2; v++)
+        {
+            uart_puts_P(PSTR("  "));
+            uart_putu(results[v][op].worst);
+            uart_puts_P(PSTR(" "));
+            uart_putu(results[v][op].total / PASSES);
+        }
+
+        uart_puts_P(PSTR("\r\n"));
+    }
+
+    for (;;);
+}
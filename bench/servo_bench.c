@@ -0,0 +1,194 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * AVR cycle benchmark for the servo pulse path.
+ *
+ *  Reports the worst and mean cycle count, measured with timer 1 at clk/1,
+ *  over every pulse width from SERVO_MIN_PULSE to SERVO_MAX_PULSE:
+ *
+ *      div     - us to counts with a 32-bit multiply and divide, as before
+ *      recip   - us to counts with the 16.16 reciprocal, as counts_from_us
+ *      pass    - one main loop pass before, convert and write every time
+ *      unchg   - one main loop pass now, pulse width unchanged
+ *
+ *  The two conversions are also compared and any difference is counted.  The
+ *  4 digit display write the old pass also made is not included.
+ *
+ *  Results go out polled on the console USART, 9600 8N2.
+ *
+ *      make -C bench
+ *      avrdude -p atmega328p -U bench/avr-servo-bench
+ */
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <util/setbaud.h>
+
+#include "bibase.h"
+#include "servo.h"
+
+#define MIN_COUNTS  (2 * SERVO_MIN_PULSE)
+#define MAX_COUNTS  (2 * SERVO_MAX_PULSE)
+
+#define COUNTS_PER_US ((((uint32_t) (MAX_COUNTS - MIN_COUNTS)) << 16)        \
+                       / (SERVO_MAX_PULSE - SERVO_MIN_PULSE))
+
+typedef uint16_t (* pass_t)(uint16_t pulse_us);
+
+/* stands in for OCR1A, timer 1 is the cycle counter */
+static volatile uint16_t ocr;
+
+/* last pulse width written */
+static uint16_t written_us;
+
+static void uart_putc(char c)
+{
+    while (!(UCSR0A & _BV(UDRE0)));
+    UDR0 = c;
+}
+
+static void uart_puts_P(PGM_P s)
+{
+    char c;
+
+    while ((c = pgm_read_byte(s++)))
+    {
+        uart_putc(c);
+    }
+}
+
+static void uart_putu(uint32_t v)
+{
+    uint8_t str[10];
+    uint8_t n = bibase32(v, str, 256 - 10);
+
+    if (0 == n)
+    {
+        uart_putc('0');
+    }
+
+    while (n)
+    {
+        uart_putc('0' + str[--n]);
+    }
+}
+
+static uint16_t __attribute__((__noinline__)) conv_div(uint16_t pulse_us)
+{
+    return (uint16_t) (MIN_COUNTS + (((uint32_t) (pulse_us - SERVO_MIN_PULSE)
+                       * (uint32_t) (MAX_COUNTS - MIN_COUNTS))
+                       / (uint32_t) (SERVO_MAX_PULSE - SERVO_MIN_PULSE)));
+}
+
+static uint16_t __attribute__((__noinline__)) conv_recip(uint16_t pulse_us)
+{
+    return (uint16_t) (MIN_COUNTS + (((uint32_t) (pulse_us - SERVO_MIN_PULSE)
+                       * COUNTS_PER_US + 0x8000UL) >> 16));
+}
+
+static uint16_t pass_old(uint16_t pulse_us)
+{
+    uint16_t const counts = conv_div(pulse_us);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ocr = counts;
+    }
+
+    return counts;
+}
+
+static uint16_t pass_unchanged(uint16_t pulse_us)
+{
+    if (pulse_us != written_us)
+    {
+        written_us = pulse_us;
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            ocr = conv_recip(pulse_us);
+        }
+    }
+
+    return 0;
+}
+
+static void bench(PGM_P name, pass_t pass)
+{
+    uint16_t worst = 0;
+    uint32_t total = 0;
+    uint16_t us;
+
+    for (us = SERVO_MIN_PULSE; us <= SERVO_MAX_PULSE; us++)
+    {
+        uint16_t start, cycles;
+
+        /* unchanged, as on all but the first pass after a change */
+        written_us = us;
+
+        TCNT1 = 0;
+        start = TCNT1;
+        pass(us);
+        cycles = TCNT1 - start;
+
+        if (cycles > worst) worst = cycles;
+        total += cycles;
+    }
+
+    uart_puts_P(name);
+    uart_puts_P(PSTR(" worst "));
+    uart_putu(worst);
+    uart_puts_P(PSTR(" mean "));
+    uart_putu(total / (SERVO_MAX_PULSE - SERVO_MIN_PULSE + 1));
+    uart_puts_P(PSTR("\r\n"));
+}
+
+int main(void)
+{
+    uint16_t differ = 0;
+    uint16_t us;
+
+    UBRR0 = UBRR_VALUE;
+    UCSR0A = USE_2X ? _BV(U2X0) : 0;
+    UCSR0C = _BV(UCSZ00) | _BV(UCSZ01) | _BV(USBS0);
+    UCSR0B = _BV(TXEN0);
+
+    /* timer 1 free running at clk/1, one count per cycle */
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    for (us = SERVO_MIN_PULSE; us <= SERVO_MAX_PULSE; us++)
+    {
+        if (conv_div(us) != conv_recip(us))
+        {
+            differ++;
+        }
+    }
+
+    uart_puts_P(PSTR("differ "));
+    uart_putu(differ);
+    uart_puts_P(PSTR("\r\n"));
+
+    bench(PSTR("div  "), conv_div);
+    bench(PSTR("recip"), conv_recip);
+    bench(PSTR("pass "), pass_old);
+    bench(PSTR("unchg"), pass_unchanged);
+
+    for (;;);
+}
@@ -20,7 +20,45 @@
 #include <stdint.h>
 
 
+/*
+ * Shift the bits of bi into the digit string str, least significant digit
+ * first.  nbase is the two's complement of the base, 246 for decimal.  Returns
+ * the updated digit count.
+ */
 extern uint8_t bibase(uint8_t n_digit, uint8_t bi, uint8_t * const str, uint8_t const nbase);
 
+/*
+ * Multi-precision form of bibase, bi points to a len byte integer.
+ */
+extern uint8_t bibase_mp(uint8_t n_digit, uint8_t const * bi, uint8_t len, uint8_t * const str, uint8_t const nbase);
+
+/*
+ * Pack a digit string two digits per byte (packed BCD for decimal).
+ */
+extern uint8_t bibase_pack(uint8_t n_digit, uint8_t * const str);
+
+#if !defined(__AVR__)
+/*
+ * Portable C equivalents of bibase and bibase_mp, host builds only.
+ */
+extern uint8_t bibase_ref(uint8_t n_digit, uint8_t bi, uint8_t * const str, uint8_t const nbase);
+extern uint8_t bibase_mp_ref(uint8_t n_digit, uint8_t const * bi, uint8_t len, uint8_t * const str, uint8_t const nbase);
+#endif /* !__AVR__ */
+
+static __inline uint8_t bibase16(uint16_t bi, uint8_t * const str, uint8_t const nbase)
+{
+    return bibase_mp(0, (uint8_t const *) &bi, sizeof(bi), str, nbase);
+}
+
+static __inline uint8_t bibase32(uint32_t bi, uint8_t * const str, uint8_t const nbase)
+{
+    return bibase_mp(0, (uint8_t const *) &bi, sizeof(bi), str, nbase);
+}
+
+static __inline uint8_t bibase64(uint64_t bi, uint8_t * const str, uint8_t const nbase)
+{
+    return bibase_mp(0, (uint8_t const *) &bi, sizeof(bi), str, nbase);
+}
+
 #endif /* !_BIBASE_H_ */
 
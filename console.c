@@ -19,11 +19,14 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/sleep.h>
+#include <avr/pgmspace.h>
 #include <util/setbaud.h>
 #include <util/atomic.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "librb.h"
+#include "timer.h"
 #include "console.h"
 
 /*
@@ -34,6 +37,8 @@
 #define KILL    ('U' & ~0x40)   /* ctrl-U              */
 #define NL      ('\n')          /* newline (line feed) */
 #define SPACE   (' ')           /* space               */
+#define XON     ('Q' & ~0x40)   /* ctrl-Q              */
+#define XOFF    ('S' & ~0x40)   /* ctrl-S              */
 
 /*
  * Transmit and receive ring-buffers.
@@ -49,6 +54,17 @@ static uint8_t rx_buffer[RX_BUF_SIZE];
 static struct ring_buffer tx_rb;
 static struct ring_buffer rx_rb;
 
+/*
+ * Receive ring-buffer water marks for flow control, stop the sender at high
+ * and resume at low.
+ */
+#ifndef RX_HIGH_WATER
+#define RX_HIGH_WATER (RX_BUF_SIZE - 8)
+#endif
+#ifndef RX_LOW_WATER
+#define RX_LOW_WATER (RX_BUF_SIZE / 4)
+#endif
+
 /*
  * Terminal attributes.
  *
@@ -82,22 +98,92 @@ static struct ring_buffer rx_rb;
 #define clr_erase_state()  bitmask_clear(&tx_rb.flags,RB_SPARE1_MSK|RB_SPARE2_MSK)
 #define is_erase_state1()   bitmask_test(&tx_rb.flags,RB_SPARE1_MSK)
 #define is_erase_state2()   bitmask_test(&tx_rb.flags,RB_SPARE2_MSK)
+#define set_tx_bol()         bitmask_set(&tx_rb.flags,RB_SPARE4_MSK)
+#define clr_tx_bol()       bitmask_clear(&tx_rb.flags,RB_SPARE4_MSK)
+#define is_tx_bol()         bitmask_test(&tx_rb.flags,RB_SPARE4_MSK)
 
 /*
  * Used in canonical mode to mark the beginning of the current line.
  */
 static uint8_t * volatile line_start;
 
+/*
+ * Timebase tick of each received newline not yet consumed, oldest first.
+ * With more than LINE_STAMPS lines queued the newest stamp is overwritten.
+ * line_stamped is set while the line returned by console_readline owns the
+ * oldest stamp.
+ */
+#define LINE_STAMPS (4)
+static tbtick_t line_stamp[LINE_STAMPS];
+static uint8_t line_stamp_get;
+static uint8_t line_stamp_count;
+static uint8_t line_stamped;
+
+static void line_stamp_drop(void)
+{
+    if (line_stamp_count) {
+        line_stamp_get = (line_stamp_get + 1) % LINE_STAMPS;
+        line_stamp_count--;
+    }
+}
+
 /*
  * Count of echoed characters to be erased with BS-SP-BS sequence.
  */
 static uint8_t erase_count;
 
+/*
+ * Binary frame queued for transmission.  Frame bytes are sent untranslated and
+ * only start at the beginning of a line of text output, or when there is no
+ * text output pending.  Once the first byte is sent (frame state) the rest go
+ * out back to back, ahead of erase echo, text and flow characters.
+ */
+static uint8_t const * frame_ptr;
+static volatile uint8_t frame_len;
+static uint8_t frame_state;
+
+#define set_frame_state() (frame_state = 1)
+#define clr_frame_state() (frame_state = 0)
+#define is_frame_state()  (frame_state)
+
+/*
+ * Flow control state.
+ *
+ *  FLOW_TX_STOPPED - The remote end asked us to stop sending, XOFF or CTS.
+ *  FLOW_RX_STOPPED - We asked the remote end to stop sending, XOFF or RTS.
+ *
+ *  tx_flow_char is an XON or XOFF waiting to be sent, it goes out ahead of
+ *  everything else and even when transmit is stopped, but never inside a
+ *  binary frame, frame bytes can be XON or XOFF themselves.  A pending flow
+ *  character keeps a frame from starting, one raised mid-frame waits for the
+ *  frame to end.  With XON/XOFF and binary frames RX_HIGH_WATER needs room
+ *  for the bytes received during the longest frame.
+ */
+#define FLOW_TX_STOPPED _BV(0)
+#define FLOW_RX_STOPPED _BV(1)
+
+static volatile uint8_t flow_state;
+static uint8_t tx_flow_char;
+
+/*
+ * Traffic statistics.
+ */
+static struct console_stats stats;
+
 /*
  * Enable transmitter and transmit buffer empty interrupt.
  */
 #define tx_enable() bitmask_set_clear(&UCSR0B,_BV(UDRIE0)|_BV(TXEN0),_BV(TXCIE0))
 
+/*
+ * Enable transmitter and route the transmit buffer empty interrupt through the
+ * slow path, for anything other than plain transmit ring-buffer output.
+ */
+#define tx_enable_slow() do {                                                  \
+    GPIOR0 |= CONSOLE_EV_SLOW;                                                 \
+    tx_enable();                                                               \
+} while (0)
+
 /*
  * Enable transmit complete interrupt.
  */
@@ -119,6 +205,112 @@ static uint8_t erase_count;
 #define rx_disable() bitmask_clear(&UCSR0B,_BV(RXCIE0))
 
 
+/*
+ * Number of bytes held in the receive ring-buffer, including those not yet
+ * echoed.  Must be called with interrupts disabled.
+ */
+#define rx_count() rb_count(&rx_rb)
+
+
+/*
+ * Record transmit bytes queued and the transmit high-water mark.  Must be
+ * called with interrupts disabled.
+ */
+static void tx_account(uint8_t n)
+{
+    uint8_t const count = rb_count(&tx_rb);
+
+    stats.tx_bytes += n;
+    if (count > stats.tx_high) stats.tx_high = count;
+}
+
+
+/*
+ * Return non-zero if the reader can drain the receive ring-buffer.  In
+ * canonical mode only complete lines are consumed, a partial line stays put
+ * until its newline arrives.
+ */
+#define rx_flow_drains() (!is_icanon() || (rx_rb.get != line_start))
+
+
+/*
+ * Ask the remote end to stop sending once the receive ring-buffer reaches the
+ * high water mark.  Never stop for a partial line, nothing would resume it.
+ * Called from the receive interrupt.
+ */
+static void rx_flow_stop(void)
+{
+#if CONSOLE_FLOW != CONSOLE_FLOW_NONE
+    if ((flow_state & FLOW_RX_STOPPED) || (rx_count() < RX_HIGH_WATER) ||
+        !rx_flow_drains()) return;
+
+    flow_state |= FLOW_RX_STOPPED;
+
+#if CONSOLE_FLOW == CONSOLE_FLOW_XONXOFF
+    tx_flow_char = XOFF;
+    tx_enable_slow();
+#else
+    pinmap_set(CONSOLE_RTS);
+#endif
+#endif
+}
+
+
+/*
+ * Let the remote end resume sending once the receive ring-buffer drains to the
+ * low water mark, or once only a partial line is left.  Called after bytes are
+ * removed, with interrupts disabled.
+ */
+static void rx_flow_resume(void)
+{
+#if CONSOLE_FLOW != CONSOLE_FLOW_NONE
+    if (!(flow_state & FLOW_RX_STOPPED) ||
+        ((rx_count() > RX_LOW_WATER) && rx_flow_drains())) return;
+
+    flow_state &= ~FLOW_RX_STOPPED;
+
+#if CONSOLE_FLOW == CONSOLE_FLOW_XONXOFF
+    tx_flow_char = XON;
+    tx_enable_slow();
+#else
+    pinmap_clear(CONSOLE_RTS);
+#endif
+#endif
+}
+
+
+/*
+ * Stop or resume transmit on a remote request.  Stopping routes the transmit
+ * buffer empty interrupt through the slow path, which holds off output, so
+ * the fast path never tests the flow state.
+ */
+#if CONSOLE_FLOW != CONSOLE_FLOW_NONE
+static void tx_flow(uint8_t stop)
+{
+    if (stop) {
+        flow_state |= FLOW_TX_STOPPED;
+        GPIOR0 |= CONSOLE_EV_SLOW;
+    }
+    else {
+        flow_state &= ~FLOW_TX_STOPPED;
+        tx_enable_slow();
+    }
+}
+#endif
+
+
+#if CONSOLE_FLOW == CONSOLE_FLOW_RTSCTS
+/*
+ * CTS pin change interrupt handler.  A byte already in the USART still goes
+ * out after CTS is deasserted, the remote end must allow for two.
+ */
+ISR(CONSOLE_CTS_vect)
+{
+    tx_flow(pinmap_test(CONSOLE_CTS));
+}
+#endif
+
+
 /*
  * Tx complete interrupt handler.  Last transmission is complete and transmit
  * ring buffer is empty.
@@ -132,12 +324,118 @@ ISR(USART_TX_vect)
 /*
  * Tx data register empty interrupt handler.  Transmitter can accept data and
  * transmit data available.
+ *
+ *  The vector only tests CONSOLE_EV_SLOW and jumps to one of two handlers.
+ *  udre_fast handles the common case, bytes from the transmit ring-buffer with
+ *  nothing else pending, with the ring-buffer get inlined.  udre_slow handles
+ *  echo, erase, the second half of NL to CR-NL and binary frames, and drops
+ *  back to the fast path once none of them are pending.
+ *
+ *  Invariant: when CONSOLE_EV_SLOW is clear and the interrupt is enabled the
+ *  transmit ring-buffer is not empty.
+ *
+ *  bench/console_bench.c reports the cycles per byte through each path.
+ */
+#if defined(__AVR__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmisspelled-isr"
+void udre_fast(void) __attribute__((__signal__, __used__));
+void udre_slow(void) __attribute__((__signal__, __used__));
+#pragma GCC diagnostic pop
+
+ISR(USART_UDRE_vect, ISR_NAKED)
+{
+    __asm__ __volatile__ (
+        "               sbic            %[gpior0], %[slow]                   \n"
+        "               jmp             udre_slow                            \n"
+        "               jmp             udre_fast                            \n"
+        :
+        : [gpior0] "I" (_SFR_IO_ADDR(GPIOR0)),
+          [slow] "I" (CONSOLE_EV_SLOW_BIT)
+    );
+}
+#else
+/*
+ * The same dispatch in C, for the host simulation in host/console_test.c.
  */
+void udre_fast(void);
+void udre_slow(void);
+
 ISR(USART_UDRE_vect)
+{
+    if (GPIOR0 & CONSOLE_EV_SLOW) udre_slow();
+    else udre_fast();
+}
+#endif /* __AVR__ */
+
+
+void udre_fast(void)
+{
+    uint8_t * get = tx_rb.get;
+    uint8_t c = *get;
+
+    rb_inc_ptr(&tx_rb, get);
+    tx_rb.get = get;
+    rb_clr_cantput(&tx_rb);
+
+    if (c == NL) {
+        set_tx_bol();
+
+        if (is_onlcr()) {
+            /*
+             * (ONLCR) Start NL to CR-NL expansion, the slow path completes it.
+             */
+            set_onlcr_state();
+            GPIOR0 |= CONSOLE_EV_SLOW;
+            c = CR;
+        }
+    }
+    else {
+        clr_tx_bol();
+    }
+
+    UDR0 = c;
+
+    if (get == tx_rb.echo) {
+        rb_set_cantget(&tx_rb);
+
+        if (!(GPIOR0 & CONSOLE_EV_SLOW)) tx_complete();
+    }
+}
+
+
+void udre_slow(void)
 {
     uint8_t c;
 
-    if (erase_count) {
+    if (tx_flow_char && !is_frame_state()) {
+        /*
+         * XON or XOFF, sent even when transmit is stopped.
+         */
+        c = tx_flow_char;
+        tx_flow_char = 0;
+    }
+    else if (flow_state & FLOW_TX_STOPPED) {
+        /*
+         * Hold off output, tx_flow re-enables the interrupt on resume.
+         */
+        bitmask_clear(&UCSR0B, _BV(UDRIE0));
+        return;
+    }
+    else if (is_frame_state() ||
+             (frame_len && !erase_count && !is_onlcr_state() &&
+              (is_tx_bol() || rb_is_cantget(&tx_rb)))) {
+        /*
+         * Raw frame byte, bypasses ONLCR.  Holding the line state at the
+         * beginning of a line keeps text out until the frame is complete,
+         * the frame state keeps erase echo and flow characters out.
+         */
+        set_frame_state();
+        set_tx_bol();
+        c = *frame_ptr++;
+        if (!--frame_len) clr_frame_state();
+    }
+    else if (erase_count) {
         /*
          * (ECHOE) Echo error correcting ERASE.
          */
@@ -168,7 +466,22 @@ ISR(USART_UDRE_vect)
         /*
          * Get next echo or output byte.
          */
-        if (rb_echo(&rx_rb, &c) < 0) rb_get(&tx_rb, &c);
+        if (rb_echo(&rx_rb, &c) < 0) {
+            if (rb_get(&tx_rb, &c) < 0) {
+                /*
+                 * Nothing left, the pending echo byte was erased or
+                 * transmit resumed with nothing queued.  Nothing was
+                 * written so TXC may never come, turn the transmitter off
+                 * now, a byte still shifting out completes first.
+                 */
+                GPIOR0 &= ~CONSOLE_EV_SLOW;
+                tx_disable();
+                return;
+            }
+
+            if (c == NL) set_tx_bol();
+            else clr_tx_bol();
+        }
 
         if (is_onlcr() && (c == NL)) {
             /*
@@ -186,15 +499,21 @@ ISR(USART_UDRE_vect)
     UDR0 = c;
 
     /*
-     * Test for additional transmit data.
-     *  1. Transmit ring buffer not empty.
-     *  2. Receive ring buffer holds characters to be echoed.
-     *  3. Uncompleted erase sequence.
-     *  4. Uncompleted NL to CR-NL translation.
+     * Test for additional slow path transmit data.
+     *  1. Receive ring buffer holds characters to be echoed.
+     *  2. Uncompleted erase sequence.
+     *  3. Uncompleted NL to CR-NL translation.
+     *  4. Binary frame bytes remaining.
+     *  5. Flow control character pending or transmit stopped.
      */
-    if (rb_is_cantget(&tx_rb) && rb_is_cantecho(&rx_rb) &&
-        !erase_count && !is_onlcr_state()) {
-        tx_complete();
+    if (rb_is_cantecho(&rx_rb) && !erase_count && !is_onlcr_state() &&
+        !frame_len && !tx_flow_char && !(flow_state & FLOW_TX_STOPPED)) {
+        GPIOR0 &= ~CONSOLE_EV_SLOW;
+
+        /*
+         * Transmit ring buffer empty.
+         */
+        if (rb_is_cantget(&tx_rb)) tx_complete();
     }
 }
 
@@ -204,13 +523,25 @@ ISR(USART_UDRE_vect)
  */
 ISR(USART_RX_vect)
 {
+    uint8_t status;
+    uint8_t count;
     uint8_t c;
 
     /*
-     * Get byte from USART data register.
+     * Get status then byte from USART data register, the error flags belong
+     * to the byte in the receive buffer.
      */
+    status = UCSR0A;
     c = UDR0;
 
+    stats.rx_bytes++;
+
+    if (status & (_BV(DOR0) | _BV(FE0) | _BV(UPE0))) {
+        if (status & _BV(DOR0)) stats.rx_overrun++;
+        if (status & _BV(FE0)) stats.rx_frame++;
+        if (status & _BV(UPE0)) stats.rx_parity++;
+    }
+
     /*
      * Strip the MSb if ASCII only.
      */
@@ -221,6 +552,16 @@ ISR(USART_RX_vect)
      */
     if (is_icrnl() && (c == CR)) c = NL;
 
+#if CONSOLE_FLOW == CONSOLE_FLOW_XONXOFF
+    /*
+     * XON and XOFF start and stop transmit and are discarded.
+     */
+    if ((c == XON) || (c == XOFF)) {
+        tx_flow(c == XOFF);
+        return;
+    }
+#endif
+
     /*
      * Canonical Mode Input Processing
      */
@@ -232,9 +573,14 @@ ISR(USART_RX_vect)
              */
             if ((rx_rb.put != line_start) && rb_erase(&rx_rb) && is_echo()) {
                 erase_count++;
-                tx_enable();
+                tx_enable_slow();
             }
 
+            /*
+             * The sender may be stopped with no complete line to consume.
+             */
+            rx_flow_resume();
+
             /*
              * ERASE character is discarded.
              */
@@ -246,7 +592,9 @@ ISR(USART_RX_vect)
              */
             erase_count += rb_kill(&rx_rb, line_start);
 
-            if (erase_count) tx_enable();
+            if (erase_count) tx_enable_slow();
+
+            rx_flow_resume();
 
             /*
              * KILL character is discarded.
@@ -272,19 +620,44 @@ ISR(USART_RX_vect)
          * in canonical mode the last character in the buffer must be a newline.
          */
         rb_erase(&rx_rb);
+        stats.rx_dropped++;
     }
-    else if (is_echo()) tx_enable();
+    else if (is_echo()) tx_enable_slow();
 
     /*
      * A newline means the end of the current line and and the beginning of
      * a new current line.
      */
-    if (c == NL) line_start = rx_rb.put;
+    if (c == NL) {
+        line_start = rx_rb.put;
+
+        if (is_icanon()) {
+            if (line_stamp_count < LINE_STAMPS) line_stamp_count++;
+            line_stamp[(line_stamp_get + line_stamp_count - 1) % LINE_STAMPS] =
+                tbtick_update();
+        }
+    }
+
+    /*
+     * Wake the main loop for a complete line, or any input if not canonical.
+     */
+    if ((c == NL) || !is_icanon()) GPIOR0 |= CONSOLE_EV_RX;
+
+    /*
+     * Receive high-water mark.
+     */
+    count = rx_count();
+    if (count > stats.rx_high) stats.rx_high = count;
 
     /*
-     * If receive ring buffer is full disable receiver interrupt.
+     * Past the high water mark ask the sender to stop.  If receive ring buffer
+     * is full disable receiver interrupt.
      */
-    if (rb_full(&rx_rb)) rx_disable();
+    rx_flow_stop();
+    if (rb_full(&rx_rb)) {
+        rx_disable();
+        GPIOR0 |= CONSOLE_EV_RX;
+    }
 }
 
 
@@ -310,12 +683,17 @@ void console_setattr(uint16_t attr)
  */
 int console_putchar(char c, struct __file * stream)
 {
+    tbtick_t blocked = 0;
+
     for (;;) {
         set_sleep_mode(SLEEP_MODE_IDLE);
         cli();
 
         if (rb_put(&tx_rb, (uint8_t *) &c) >= 0) break;
 
+        /* start of the wait, never 0 which means not blocked */
+        if (!blocked) blocked = tbtick_update() | 1;
+
         /* Wait for an interrupt before trying again. */
         SMCR = SLEEP_MODE_IDLE | _BV(SE);
         sei();
@@ -323,6 +701,9 @@ int console_putchar(char c, struct __file * stream)
         SMCR = SLEEP_MODE_IDLE;
     }
 
+    tx_account(1);
+    if (blocked) stats.tx_blocked += tbtick_update() - blocked;
+
     tx_enable();
     sei();
 
@@ -330,6 +711,131 @@ int console_putchar(char c, struct __file * stream)
 }
 
 
+/*
+ * write, copies whole buffers into the transmit ring-buffer, this call always
+ * blocks until the entire buffer is queued
+ */
+int console_write(void const * buf, size_t len)
+{
+    uint8_t const * p = buf;
+    tbtick_t blocked = 0;
+
+    for (;;) {
+        size_t n = len;
+
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        cli();
+
+        /* up to two contiguous copies into the transmit ring-buffer */
+        if ((rb_write(&tx_rb, p, &n) >= 0) && n) {
+            tx_account(n);
+            tx_enable();
+        }
+
+        p += n;
+        len -= n;
+
+        if (!len) break;
+
+        /* start of the wait, never 0 which means not blocked */
+        if (!blocked) blocked = tbtick_update() | 1;
+
+        /* Wait for an interrupt before trying again. */
+        SMCR = SLEEP_MODE_IDLE | _BV(SE);
+        sei();
+        sleep_cpu();
+        SMCR = SLEEP_MODE_IDLE;
+    }
+
+    if (blocked) stats.tx_blocked += tbtick_update() - blocked;
+
+    sei();
+
+    return 0;
+}
+
+
+/*
+ * trywrite, copies a whole buffer into the transmit ring-buffer only if there
+ * is room for all of it, this call never blocks
+ *
+ *  Returns -1 and queues nothing if the buffer does not fit.
+ */
+int8_t console_trywrite(void const * buf, size_t len)
+{
+    int8_t ret = -1;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (len <= sizeof(tx_buffer) - rb_count(&tx_rb)) {
+            if (len && (rb_write(&tx_rb, buf, &len) >= 0)) {
+                tx_account(len);
+                tx_enable();
+            }
+
+            ret = 0;
+        }
+    }
+
+    return ret;
+}
+
+
+/*
+ * tx_room, bytes the transmit ring-buffer can take without blocking
+ */
+size_t console_tx_room(void)
+{
+    size_t room;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        room = sizeof(tx_buffer) - rb_count(&tx_rb);
+    }
+
+    return room;
+}
+
+
+/*
+ * puts, write a string without a trailing newline
+ */
+int console_puts(char const * s)
+{
+    return console_write(s, strlen(s));
+}
+
+
+/*
+ * frame, queue a binary frame for transmission
+ *
+ *  The frame is sent as is, without ONLCR translation, between lines of text
+ *  output.  The caller must leave the buffer untouched until
+ *  console_frame_busy returns 0.  Returns -1 if a frame is already queued.
+ */
+int8_t console_frame(uint8_t const * frame, uint8_t len)
+{
+    int8_t ret = -1;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (!frame_len) {
+            frame_ptr = frame;
+            frame_len = len;
+
+            if (len) tx_enable_slow();
+
+            ret = 0;
+        }
+    }
+
+    return ret;
+}
+
+
+uint8_t console_frame_busy(void)
+{
+    return frame_len;
+}
+
+
 /*
  * getchar, this call can be blocking or non-blocking
  */
@@ -361,6 +867,9 @@ int console_getchar(struct __file * stream)
         SMCR = SLEEP_MODE_IDLE;
     }
 
+    if (c == NL) line_stamp_drop();
+
+    rx_flow_resume();
     rx_enable();
     sei();
 
@@ -368,6 +877,342 @@ int console_getchar(struct __file * stream)
 }
 
 
+/*
+ * readline, return the next complete line as one or two spans pointing into
+ * the receive ring-buffer, this call can be blocking or non-blocking
+ *
+ *  In canonical mode a line ends with and includes the newline, or is the
+ *  entire buffer when it is full.  In non-canonical mode all available input
+ *  is returned.  The line remains in the buffer until released with
+ *  console_consume.
+ */
+int16_t console_readline(struct console_line * const line)
+{
+    uint8_t * get;
+    uint8_t * end;
+
+    for (;;) {
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        cli();
+
+        line_stamped = 0;
+
+        if (!rb_is_cantget(&rx_rb)) {
+            get = rx_rb.get;
+            end = rx_rb.echo;
+
+            if (!is_icanon() || rb_full(&rx_rb)) break;
+
+            /* scan for the end of the line */
+            uint8_t * p = get;
+            uint8_t c;
+
+            do {
+                c = *p;
+                rb_inc_ptr(&rx_rb, p);
+            } while ((c != NL) && (p != end));
+
+            if (c == NL) {
+                end = p;
+                line_stamped = (line_stamp_count != 0);
+                break;
+            }
+        }
+
+        if (is_inonblock()) {
+            sei();
+            return _FDEV_EOF;
+        }
+
+        /* Wait for an interrupt before trying again. */
+        SMCR = SLEEP_MODE_IDLE | _BV(SE);
+        sei();
+        sleep_cpu();
+        SMCR = SLEEP_MODE_IDLE;
+    }
+
+    /* when the newline was received, or now for a line without one */
+    line->tbtick = line_stamped ? line_stamp[line_stamp_get] : tbtick_update();
+
+    sei();
+
+    /*
+     * The line is stable, the receiver only appends after the current line.
+     */
+    line->ptr[0] = get;
+    line->ptr[1] = rx_rb.start;
+
+    if (end > get) {
+        line->len[0] = end - get;
+        line->len[1] = 0;
+    }
+    else {
+        line->len[0] = rx_rb.limit - get;
+        line->len[1] = end - rx_rb.start;
+    }
+
+    return line->len[0] + line->len[1];
+}
+
+
+/*
+ * consume, release len bytes returned by console_readline
+ */
+void console_consume(uint8_t len)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        rb_commit(&rx_rb, len);
+
+        /* the line's newline stamp goes with it */
+        if (line_stamped) line_stamp_drop();
+        line_stamped = 0;
+
+        rx_flow_resume();
+        rx_enable();
+
+        /* there may be another line behind this one */
+        if (!rb_is_cantget(&rx_rb)) GPIOR0 |= CONSOLE_EV_RX;
+    }
+}
+
+
+void console_get_stats(struct console_stats * this_stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *this_stats = stats;
+    }
+}
+
+
+void console_clear_stats(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        memset(&stats, 0, sizeof(stats));
+    }
+}
+
+
+/*
+ * Baud rate error tolerance, 1/BAUD_TOL (2%).
+ */
+#define BAUD_TOL (50UL)
+
+static uint8_t baud_ok(uint32_t baud, uint32_t ubrr, uint8_t div)
+{
+    uint32_t actual;
+
+    if ((ubrr == 0) || (ubrr > 4096)) return 0;
+
+    actual = F_CPU / (div * ubrr);
+
+    return ((actual > baud) ? (actual - baud) : (baud - actual))
+           <= (baud / BAUD_TOL);
+}
+
+
+/*
+ * setbaud, change the baud rate at runtime
+ *
+ *  The transmitter is drained before the rate is changed.  U2X is used only
+ *  when the normal rate is out of tolerance, as util/setbaud.h does.  Returns
+ *  -1 if the rate can not be generated within tolerance from F_CPU.
+ */
+int8_t console_setbaud(uint32_t baud)
+{
+    uint32_t ubrr;
+    uint8_t ucsr0a;
+    uint8_t drained = 0;
+
+    if (baud == 0) return -1;
+
+    ubrr = UDIV_ROUND(F_CPU, 16UL * baud);
+    ucsr0a = 0;
+
+    if (!baud_ok(baud, ubrr, 16)) {
+        ubrr = UDIV_ROUND(F_CPU, 8UL * baud);
+        ucsr0a = _BV(U2X0);
+
+        if (!baud_ok(baud, ubrr, 8)) return -1;
+    }
+
+    for (;;) {
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        cli();
+
+        /* the transmitter is disabled once its queue is empty */
+        if (!(UCSR0B & _BV(TXEN0))) {
+            if (drained) break;
+
+            /*
+             * TXEN0 reads clear as soon as it is written, a last byte may
+             * still be shifting out.  Allow one 11 bit frame at the old rate
+             * then check nothing was queued meanwhile.
+             */
+            sei();
+            tbtick_delay(UDIV_CEILING(11UL * ((UCSR0A & _BV(U2X0)) ? 8 : 16) *
+                                      (UBRR0 + 1UL), TBTIMER_PRESCALER));
+            drained = 1;
+            continue;
+        }
+
+        drained = 0;
+
+        /* Wait for an interrupt before trying again. */
+        SMCR = SLEEP_MODE_IDLE | _BV(SE);
+        sei();
+        sleep_cpu();
+        SMCR = SLEEP_MODE_IDLE;
+    }
+
+    UBRR0 = ubrr - 1;
+    UCSR0A = ucsr0a;
+
+    sei();
+
+    return 0;
+}
+
+
+#ifdef CONSOLE_AUTOBAUD
+/*
+ * Standard rates the measured rate is snapped to.
+ */
+static const uint32_t PROGMEM standard_baud[] = {
+    2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 76800, 115200,
+};
+
+/*
+ * Timer 1 counts between two samples, allowing for a PWM TOP set in ICR1.
+ */
+static uint16_t timer1_elapsed(uint16_t t0, uint16_t t1)
+{
+    uint16_t const top = (TCCR1B & _BV(WGM13)) ? ICR1 : 0xFFFF;
+
+    return (t1 >= t0) ? (t1 - t0) : (t1 + (top - t0) + 1);
+}
+
+/*
+ * Bound on the polls for one edge of the sync character.  A poll is at least
+ * four cycles, so this is at least two bit times at the slowest standard
+ * rate.  A line that does not change within that is not a sync character.
+ */
+#define AUTOBAUD_SPIN ((uint16_t) (F_CPU / 4800UL))
+
+/*
+ * Longest wait for the sync character, the caller's main loop is stalled
+ * for this long.
+ */
+#define AUTOBAUD_MAX_TIMEOUT TBTICKS_FROM_MS(2000)
+
+/*
+ * Wait for RXD to read high (level 1) or low (level 0).  Returns 0 if it does
+ * not within AUTOBAUD_SPIN polls.  Inlined to keep the poll loop tight.
+ */
+static __inline__ uint8_t rxd_wait(uint8_t level) __attribute__((__always_inline__));
+static __inline__ uint8_t rxd_wait(uint8_t level)
+{
+    uint16_t spin = AUTOBAUD_SPIN;
+
+    while (!pinmap_test(PINMAP_RXD) != !level) {
+        if (!--spin) return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * autobaud, measure a sync character and set the baud rate to match
+ *
+ *  The sync character is 'U' (0x55), which with the start bit gives five
+ *  falling edges exactly two bit times apart.  Six bit times are timed with
+ *  timer 1 (clk/8) while interrupts are disabled, good to about a count.
+ *  That resolves every rate in standard_baud, higher rates must be set with
+ *  console_setbaud.  timeout is in timebase ticks, at most
+ *  AUTOBAUD_MAX_TIMEOUT.  Interrupts stay on while waiting for idle and the
+ *  start bit, they are off only from the start bit to the stop bit, one
+ *  character time.  Each edge must follow within AUTOBAUD_SPIN polls, so a
+ *  stuck or noisy line ends the measurement, never holds interrupts off.
+ *
+ *  Returns the new baud rate, or 0 on timeout or if the measurement is not
+ *  close to a standard rate.
+ */
+uint32_t console_autobaud(uint32_t timeout)
+{
+    uint32_t baud = 0;
+    uint16_t t0 = 0;
+    uint16_t t1 = 0;
+    tbtick_t start;
+
+    uint8_t idle = 0;
+
+    if (timeout > AUTOBAUD_MAX_TIMEOUT) timeout = AUTOBAUD_MAX_TIMEOUT;
+
+    /* receiver off, the pin is sampled directly */
+    UCSR0B &= ~(_BV(RXEN0) | _BV(RXCIE0));
+
+    start = tbtick_update();
+
+    /* wait for idle then the falling edge of the start bit, interrupts on */
+    for (;;) {
+        if (pinmap_test(PINMAP_RXD)) idle = 1;
+        else if (idle) break;
+
+        if ((tbtick_st) (tbtick_update() - start) > (tbtick_st) timeout) break;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        /*
+         * Still in the start bit, unless an interrupt held us past it.  The
+         * start edge is imprecise anyway, time from the falling edge at bit 2
+         * to the one at bit 8 in tight loops.  Missed edges fail the
+         * measurement, they don't skew it.
+         */
+        if (idle && !pinmap_test(PINMAP_RXD)) {
+            uint8_t edge = 0;
+
+            if (rxd_wait(1) && rxd_wait(0)) {
+                t0 = TCNT1;
+
+                for (; edge < 3; edge++) {
+                    if (!rxd_wait(1) || !rxd_wait(0)) break;
+                }
+
+                t1 = TCNT1;
+            }
+
+            /* let the stop bit pass */
+            if ((edge == 3) && rxd_wait(1)) {
+                baud = (6UL * F_CPU / TIMER1_PRESCALER)
+                       / timer1_elapsed(t0, t1);
+            }
+        }
+    }
+
+    if (baud) {
+        uint32_t best = 0;
+
+        for (uint8_t i = 0; i < ARRAY_SIZE(standard_baud); i++) {
+            uint32_t const rate = pgm_read_dword(&standard_baud[i]);
+
+            /* within 1/8 of a standard rate */
+            if ((baud > (rate - rate / 8)) && (baud < (rate + rate / 8))) {
+                best = rate;
+                break;
+            }
+        }
+
+        baud = best;
+    }
+
+    if (baud && (console_setbaud(baud) < 0)) baud = 0;
+
+    rx_enable();
+
+    return baud;
+}
+#endif /* CONSOLE_AUTOBAUD */
+
+
 /*
  * Initialize FILE structure for console device.
  */
@@ -389,6 +1234,9 @@ void console_init(void)
      * Current line is empty.
      */
     line_start = rx_rb.put; /* line_start also equals echo and get */
+    line_stamp_get = 0;
+    line_stamp_count = 0;
+    line_stamped = 0;
 
     /*
      * State variables for processing.
@@ -396,6 +1244,25 @@ void console_init(void)
     erase_count = 0;
     clr_erase_state();
     clr_onlcr_state();
+    set_tx_bol();
+    clr_frame_state();
+    frame_len = 0;
+    memset(&stats, 0, sizeof(stats));
+    flow_state = 0;
+    tx_flow_char = 0;
+    GPIOR0 &= ~CONSOLE_EV_SLOW;
+
+#if CONSOLE_FLOW == CONSOLE_FLOW_RTSCTS
+    /*
+     * RTS asserted (low) output, CTS input with pull-up interrupting on change.
+     */
+    pinmap_clear(CONSOLE_RTS);
+    pinmap_set_ddr(CONSOLE_RTS);
+    pinmap_clear_ddr(CONSOLE_CTS);
+    pinmap_set(CONSOLE_CTS);
+    pinmap_set_pcint(CONSOLE_CTS);
+    if (pinmap_test(CONSOLE_CTS)) tx_flow(1);
+#endif
 
     /*
      * Default attributes.
@@ -17,6 +17,9 @@
 #ifndef _CONSOLE_H_
 #define _CONSOLE_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 /*
  * Terminal attributes.
  *
@@ -34,9 +37,88 @@
 #define IASCII    RB_SPARE4_MSK
 #define ONLCR     (RB_SPARE3_MSK << 8)
 
+/*
+ * A line of input in the receive ring-buffer, split in two when it wraps.
+ * tbtick is the timebase tick its newline was received.
+ */
+struct console_line {
+    uint8_t const * ptr[2];
+    uint8_t len[2];
+    uint32_t tbtick;
+};
+
+/*
+ * Traffic statistics, for sizing TX_BUF_SIZE and RX_BUF_SIZE.
+ *
+ *  rx_bytes/tx_bytes - Bytes received, and queued for transmit.
+ *  rx_overrun        - USART data overruns (DOR0), at least one byte lost.
+ *  rx_frame          - Framing errors (FE0).
+ *  rx_parity         - Parity errors (UPE0).
+ *  rx_dropped        - Bytes discarded because the receive buffer was full.
+ *  rx_high/tx_high   - Ring-buffer high-water marks in bytes.
+ *  tx_blocked        - Timebase ticks spent waiting for transmit space.
+ */
+struct console_stats {
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t tx_blocked;
+    uint16_t rx_overrun;
+    uint16_t rx_frame;
+    uint16_t rx_parity;
+    uint16_t rx_dropped;
+    uint8_t rx_high;
+    uint8_t tx_high;
+};
+
+struct __file;
+
 extern uint16_t console_getattr(void);
 extern void console_setattr(uint16_t attr);
 extern int console_putchar(char c, struct __file * stream);
 extern int console_getchar(struct __file * stream);
 
+/*
+ * Bulk output.  Whole buffers are copied into the transmit ring-buffer with
+ * one critical section per ring-buffer wrap, instead of one per character as
+ * through stdio.  Output is still subject to ONLCR translation.
+ */
+extern int console_write(void const * buf, size_t len);
+extern int console_puts(char const * s);
+
+/*
+ * Non-blocking output.  The whole buffer is queued, or nothing and -1 is
+ * returned.  console_tx_room returns the bytes that can be queued now, it
+ * only grows until the caller queues more.
+ */
+extern int8_t console_trywrite(void const * buf, size_t len);
+extern size_t console_tx_room(void);
+
+/*
+ * Binary output.  A queued frame is transmitted untranslated between lines of
+ * text, see telemetry.h for the framing.
+ */
+extern int8_t console_frame(uint8_t const * frame, uint8_t len);
+extern uint8_t console_frame_busy(void);
+
+/*
+ * Zero-copy input.  console_readline returns the length of the next line and
+ * points line at it in place, or returns _FDEV_EOF if non-blocking and no line
+ * is ready.  console_consume releases the bytes once they have been parsed.
+ */
+extern int16_t console_readline(struct console_line * const line);
+extern void console_consume(uint8_t len);
+
+/*
+ * Runtime baud rate.  console_setbaud drains the transmitter and returns -1 if
+ * the rate is out of tolerance.  console_autobaud (CONSOLE_AUTOBAUD) times a
+ * 'U' sync character and returns the standard rate selected, or 0.
+ */
+extern int8_t console_setbaud(uint32_t baud);
+#ifdef CONSOLE_AUTOBAUD
+extern uint32_t console_autobaud(uint32_t timeout);
+#endif
+
+extern void console_get_stats(struct console_stats * this_stats);
+extern void console_clear_stats(void);
+
 #endif /* _CONSOLE_H_ */
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "project.h"
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+#include "bibase.h"
+#include "console.h"
+#include "log.h"
+#include "fmt.h"
+
+
+void fmt_flush(struct fmt * const f)
+{
+    if (f->len) {
+        if (f->level == FMT_CONSOLE) console_write(f->buf, f->len);
+        else log_write(f->level, f->buf, f->len);
+        f->len = 0;
+    }
+}
+
+
+void fmt_char(struct fmt * const f, char c)
+{
+    if (f->len == sizeof(f->buf)) {
+        /* a log message is one write, drop the rest and end the line */
+        if (f->level != FMT_CONSOLE) {
+            f->buf[sizeof(f->buf) - 1] = '\n';
+            return;
+        }
+
+        fmt_flush(f);
+    }
+
+    f->buf[f->len++] = c;
+}
+
+
+void fmt_str(struct fmt * const f, char const * s)
+{
+    char c;
+
+    while ((c = *s++)) fmt_char(f, c);
+}
+
+
+void fmt_str_P(struct fmt * const f, PGM_P s)
+{
+    char c;
+
+    while ((c = pgm_read_byte(s++))) fmt_char(f, c);
+}
+
+
+/*
+ * Decimal, is_signed selects int32_t or uint32_t interpretation of v and
+ * scale places the decimal point.
+ */
+void fmt_dec(struct fmt * const f, int32_t v, uint8_t is_signed, uint8_t scale)
+{
+    uint8_t dec[10];
+    uint32_t magnitude = v;
+    uint8_t n_digit;
+
+    scale = min(scale, (uint8_t) (sizeof(dec) - 1));
+
+    if (is_signed && (v < 0)) {
+        fmt_char(f, '-');
+        magnitude = -(uint32_t) v;
+    }
+
+    n_digit = bibase32(magnitude, dec, 246);
+
+    /* leading zeros up to and including the units digit */
+    while (n_digit <= scale) dec[n_digit++] = 0;
+
+    while (n_digit--) {
+        fmt_char(f, '0' + dec[n_digit]);
+        if (scale && (n_digit == scale)) fmt_char(f, '.');
+    }
+}
+
+
+void fmt_hex(struct fmt * const f, uint32_t v, uint8_t n_digit)
+{
+    while (n_digit--) {
+        uint8_t const nibble = (v >> (4 * n_digit)) & 0x0F;
+
+        fmt_char(f, nibble + ((nibble < 10) ? '0' : ('A' - 10)));
+    }
+}
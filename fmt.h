@@ -0,0 +1,86 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FMT_H_
+#define _FMT_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+/*
+ * Lightweight formatted output.
+ *
+ *  The format is resolved by the preprocessor, each field macro becomes a
+ *  direct call to its conversion function and no format string is parsed at
+ *  run time.  Fields are collected in a line buffer on the stack and handed
+ *  to console_write, one critical section per line rather than one per
+ *  character through vfprintf.
+ *
+ *      fmt_line(FMT_S("pulse "), FMT_U(pulse_us), FMT_S(" us\n"));
+ *
+ *  Decimal fields use the bibase kernel.
+ *
+ *  The buffer holds the longest line built, the uart statistics at up to 87
+ *  characters, and sets LOG_MSG_SIZE.  A console line that overflows it is
+ *  written in parts, a log line is truncated to a newline so a message is
+ *  never split.
+ */
+#ifndef FMT_LINE_SIZE
+#define FMT_LINE_SIZE (96)
+#endif
+
+/*
+ * level is FMT_CONSOLE for console output, or the log level when the line is
+ * built by log_line.
+ */
+#define FMT_CONSOLE (0xff)
+
+struct fmt {
+    uint8_t len;
+    uint8_t level;
+    char buf[FMT_LINE_SIZE];
+};
+
+#define fmt_line(...) do {                                                     \
+    struct fmt _fmt;                                                           \
+    _fmt.len = 0;                                                              \
+    _fmt.level = FMT_CONSOLE;                                                  \
+    __VA_ARGS__;                                                               \
+    fmt_flush(&_fmt);                                                          \
+} while (0)
+
+/*
+ * Field macros, valid only inside fmt_line.
+ */
+#define FMT_S(s)        fmt_str_P(&_fmt, PSTR(s))     /* literal string      */
+#define FMT_STR(s)      fmt_str(&_fmt, (s))           /* string in RAM       */
+#define FMT_C(c)        fmt_char(&_fmt, (c))          /* character           */
+#define FMT_NL          fmt_char(&_fmt, '\n')         /* newline             */
+#define FMT_U(v)        fmt_dec(&_fmt, (v), 0, 0)     /* unsigned decimal    */
+#define FMT_I(v)        fmt_dec(&_fmt, (v), 1, 0)     /* signed decimal      */
+#define FMT_FIX(v,s)    fmt_dec(&_fmt, (v), 1, (s))   /* signed fixed-point  */
+#define FMT_X8(v)       fmt_hex(&_fmt, (v), 2)        /* 2 digit hex         */
+#define FMT_X16(v)      fmt_hex(&_fmt, (v), 4)        /* 4 digit hex         */
+#define FMT_X32(v)      fmt_hex(&_fmt, (v), 8)        /* 8 digit hex         */
+
+extern void fmt_flush(struct fmt * const f);
+extern void fmt_char(struct fmt * const f, char c);
+extern void fmt_str(struct fmt * const f, char const * s);
+extern void fmt_str_P(struct fmt * const f, PGM_P s);
+extern void fmt_dec(struct fmt * const f, int32_t v, uint8_t is_signed, uint8_t scale);
+extern void fmt_hex(struct fmt * const f, uint32_t v, uint8_t n_digit);
+
+#endif /* _FMT_H_ */
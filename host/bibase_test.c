@@ -0,0 +1,206 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host equivalence test for bibase.c.
+ *
+ *  Every 8 and 16-bit value, and a sweep of 32 and 64-bit values, is converted
+ *  in each base from 2 to 16 with bibase(), bibase_mp() and the bibase16/32/64
+ *  wrappers.  Every result is checked digit for digit against repeated
+ *  division, parsed back with strtoull(), and in bases 8, 10 and 16 compared
+ *  with snprintf().  Decimal results are also checked through bibase_pack().
+ *  On the host bibase() is bibase_ref(), the step for step C model of the AVR
+ *  kernels, so these oracles are what make the test independent of it.
+ *
+ *      make -C host test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bibase.h"
+
+#define MAX_DIGITS 64
+
+static unsigned long checks;
+static unsigned long errors;
+
+static uint8_t divide(uint64_t v, uint8_t * const str, uint8_t const base)
+{
+    uint8_t n = 0;
+
+    while (v) {
+        str[n++] = v % base;
+        v /= base;
+    }
+
+    return n;
+}
+
+/*
+ * Digits, least significant first, as text most significant first.
+ */
+static void text(uint8_t n, uint8_t const * str, char * const t)
+{
+    uint8_t i = 0;
+
+    if (!n) t[i++] = '0';
+
+    while (n) t[i++] = "0123456789abcdef"[str[--n] & 0x0F];
+
+    t[i] = '\0';
+}
+
+static void oracle(char const * what, uint64_t v, uint8_t base,
+                   uint8_t n, uint8_t const * str)
+{
+    char t[MAX_DIGITS + 1];
+    char f[MAX_DIGITS + 1];
+
+    text(n, str, t);
+
+    checks++;
+
+    if (strtoull(t, NULL, base) != v) {
+        if (errors++ < 10) {
+            printf("%s: %llu base %u: \"%s\" parses back wrong\n", what,
+                   (unsigned long long) v, base, t);
+        }
+    }
+
+    if ((base != 8) && (base != 10) && (base != 16)) return;
+
+    snprintf(f, sizeof(f), (base == 8) ? "%llo" : (base == 10) ? "%llu" :
+             "%llx", (unsigned long long) v);
+
+    checks++;
+
+    if (strcmp(t, f)) {
+        if (errors++ < 10) {
+            printf("%s: %llu base %u: \"%s\", printf gives \"%s\"\n",
+                   what, (unsigned long long) v, base, t, f);
+        }
+    }
+}
+
+static void compare(char const * what, uint64_t v, uint8_t base,
+                    uint8_t n, uint8_t const * str)
+{
+    uint8_t expect[MAX_DIGITS];
+    uint8_t const m = divide(v, expect, base);
+
+    oracle(what, v, base, n, str);
+
+    checks++;
+
+    if ((n != m) || memcmp(str, expect, m)) {
+        if (errors++ < 10) {
+            printf("%s: %llu base %u: %u digits, expected %u\n", what,
+                   (unsigned long long) v, base, n, m);
+        }
+    }
+}
+
+static void check_pack(uint64_t v)
+{
+    uint8_t str[MAX_DIGITS];
+    uint8_t n = bibase64(v, str, 256 - 10);
+    uint8_t p = bibase_pack(n, str);
+    uint64_t bcd = v;
+
+    checks++;
+
+    for (uint8_t i = 0; i < p; i++) {
+        uint8_t expect = bcd % 10;
+
+        bcd /= 10;
+        expect |= (bcd % 10) << 4;
+        bcd /= 10;
+
+        if (str[i] != expect) {
+            if (errors++ < 10) {
+                printf("bibase_pack: %llu byte %u: %02x, expected %02x\n",
+                       (unsigned long long) v, i, str[i], expect);
+            }
+            return;
+        }
+    }
+
+    if (bcd || (p != (n + 1) / 2)) {
+        if (errors++ < 10) {
+            printf("bibase_pack: %llu: %u bytes\n", (unsigned long long) v, p);
+        }
+    }
+}
+
+int main(void)
+{
+    uint8_t str[MAX_DIGITS];
+    uint8_t n;
+
+    for (uint8_t base = 2; base <= 16; base++) {
+        uint8_t const nbase = 256 - base;
+
+        for (uint32_t v = 0; v < 0x100; v++) {
+            n = bibase(0, v, str, nbase);
+            compare("bibase", v, base, n, str);
+        }
+
+        for (uint32_t v = 0; v < 0x10000; v++) {
+            uint8_t const le[2] = { v, v >> 8 };
+
+            n = bibase16(v, str, nbase);
+            compare("bibase16", v, base, n, str);
+
+            n = bibase_mp(0, le, sizeof(le), str, nbase);
+            compare("bibase_mp", v, base, n, str);
+
+            /* high byte first through bibase(), as the mp kernel does */
+            n = bibase(bibase(0, v >> 8, str, nbase), v, str, nbase);
+            compare("bibase chained", v, base, n, str);
+        }
+
+        for (uint64_t v = 0; v < 0x100000000ULL; v += 65521) {
+            n = bibase32(v, str, nbase);
+            compare("bibase32", v, base, n, str);
+        }
+
+        for (uint64_t v = 1, x = 1; v; v <<= 1, x = x * 3 + 1) {
+            n = bibase64(v - 1, str, nbase);
+            compare("bibase64", v - 1, base, n, str);
+
+            n = bibase64(x, str, nbase);
+            compare("bibase64", x, base, n, str);
+        }
+
+        n = bibase64(UINT64_MAX, str, nbase);
+        compare("bibase64", UINT64_MAX, base, n, str);
+
+        /* zero length leaves the digit string untouched */
+        n = bibase_mp(3, NULL, 0, str, nbase);
+        checks++;
+        if (n != 3) errors++;
+    }
+
+    for (uint32_t v = 0; v < 0x10000; v++) check_pack(v);
+    check_pack(UINT64_MAX);
+
+    printf("bibase: %lu checks, %lu errors\n", checks, errors);
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,616 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host flow control stress test for console.c.
+ *
+ *  console.c is built against the register simulation in host/sim and driven
+ *  one byte time per tick:
+ *
+ *   - The remote sender transmits a line of text every tick it is allowed
+ *     to, full line rate.  It sees XOFF and XON, or RTS, FLOW_LAG ticks late
+ *     and keeps sending until then.
+ *   - The USART holds two received bytes while the receive interrupt is off,
+ *     a third is an overrun and is lost.
+ *   - The transmitter sends one byte per tick from the data register empty
+ *     interrupt and raises transmit complete a tick after the last byte.
+ *   - The main loop takes lines with console_readline then stays busy for up
+ *     to MAX_BUSY ticks, long enough to overflow the receive ring-buffer
+ *     many times over without flow control.
+ *   - The remote end stops and resumes our transmitter at random, with XOFF
+ *     and XON in the data or with CTS.
+ *
+ *  Every line must arrive intact and in order, every echo must match the
+ *  input, and nothing may be lost.  A directed test sends a short line then
+ *  fills a partial line past the high water mark and kills it, the sender
+ *  must be resumed without a line ever being consumed.  A last directed test
+ *  starts a binary frame then erases an echoed character and fills the
+ *  receive ring-buffer past the high water mark, the frame must go out whole
+ *  with the erase echo and any XOFF after it.  The main loop wake event,
+ *  CONSOLE_EV_RX, must be raised for a complete line and not part of one,
+ *  and raised again by console_consume while another line remains.
+ *
+ *      make -C host test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "librb.h"
+#include "console.h"
+#include "sim/avr/io.h"
+
+/* as project.h, the test is built for one of these */
+#define CONSOLE_FLOW_XONXOFF (1)
+#define CONSOLE_FLOW_RTSCTS  (2)
+
+#ifndef CONSOLE_FLOW
+#define CONSOLE_FLOW CONSOLE_FLOW_XONXOFF
+#endif
+
+#define XON  ('Q' & ~0x40)
+#define XOFF ('S' & ~0x40)
+#define KILL ('U' & ~0x40)
+#define ERASE ('\b')
+
+#define FLOW_LAG  (3)
+#define MAX_BUSY  (200)
+#define MAX_LINE  (16)
+#ifndef LINES
+#define LINES     (200000UL)
+#endif
+
+/* main loop wake event, as project.h */
+#define CONSOLE_EV_RX _BV(GPIOR03)
+
+/* CONSOLE_RTS is D2 and CONSOLE_CTS is D3 in project.h */
+#define RTS_BIT (2)
+#define CTS_BIT (3)
+
+/*
+ * Simulated registers and streams.
+ */
+volatile uint8_t GPIOR0, SMCR;
+volatile uint8_t PINB, PINC, PIND, PORTB, PORTC, PORTD, DDRB, DDRC, DDRD;
+volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2, DIDR0;
+volatile uint8_t UCSR0A, UCSR0B, UCSR0C;
+volatile uint16_t UBRR0, UDR0;
+volatile uint8_t TCNT0, OCR0A, TIFR0, TIMSK0, TCCR1B;
+volatile uint16_t TCNT1, ICR1;
+
+struct __file * sim_stdin, * sim_stdout, * sim_stderr;
+
+extern void USART_RX_vect(void);
+extern void USART_UDRE_vect(void);
+extern void USART_TX_vect(void);
+#if CONSOLE_FLOW == CONSOLE_FLOW_RTSCTS
+extern void PCINT2_vect(void);
+#endif
+
+/* marks UDR0 as not written, see sim/avr/io.h */
+#define UDR0_EMPTY (0x100)
+
+static uint32_t now;
+
+/*
+ * Remote sender.
+ */
+static char send_line[MAX_LINE + 1];
+static uint8_t send_len;
+static uint8_t send_pos;
+static uint8_t send_stopped[FLOW_LAG + 1];
+#if CONSOLE_FLOW == CONSOLE_FLOW_XONXOFF
+static uint8_t send_xoff;
+#endif
+static uint8_t send_view;
+static uint8_t send_fill;
+static char const fill_line[] = "ab\n";
+static unsigned long lines_sent;
+
+/* lines sent and not yet read, oldest first */
+#define PENDING (64)
+static char pending[PENDING][MAX_LINE + 1];
+static uint8_t pending_get;
+static uint8_t pending_count;
+
+/* echo expected from the console, NL as CR-NL */
+static char echo[4096];
+static unsigned echo_put;
+static unsigned echo_get;
+static uint8_t echo_check = 1;
+
+/* remote holding our transmitter */
+static uint32_t hold_until;
+static uint8_t holding;
+static uint8_t hold_char;
+static uint8_t hold_random = 1;
+
+/* USART receive buffer */
+static uint8_t rx_fifo[2];
+static uint8_t rx_fifo_count;
+static uint8_t tx_busy;
+
+/* console output captured for the frame test */
+static uint8_t capture[256];
+static unsigned capture_len;
+static uint8_t capturing;
+
+static unsigned long sent_bytes;
+static unsigned long stops;
+static unsigned long overruns;
+static unsigned long errors;
+
+static uint32_t busy_until;
+static unsigned long lines_read;
+
+uint32_t tbtick_update(void)
+{
+    return now;
+}
+
+void tbtick_delay(int32_t counts)
+{
+    (void) counts;
+}
+
+static void fail(char const * what)
+{
+    if (errors++ < 10) fprintf(stderr, "console: tick %u: %s\n", now, what);
+}
+
+static uint8_t random8(void)
+{
+    return rand() & 0xFF;
+}
+
+static void next_line(void)
+{
+    send_len = random8() % MAX_LINE;
+
+    for (uint8_t i = 0; i < send_len; i++) {
+        send_line[i] = ' ' + random8() % 95;
+    }
+
+    send_line[send_len++] = '\n';
+    send_line[send_len] = '\0';
+    send_pos = 0;
+}
+
+static void echo_expect(char c)
+{
+    if (!echo_check) return;
+
+    if (c == '\n') echo[echo_put++ % sizeof(echo)] = '\r';
+    echo[echo_put++ % sizeof(echo)] = c;
+}
+
+/*
+ * Byte sent by the console, as seen by the remote end.
+ */
+static void remote_receive(uint8_t c)
+{
+    if (capturing && (capture_len < sizeof(capture))) {
+        capture[capture_len++] = c;
+    }
+
+#if CONSOLE_FLOW == CONSOLE_FLOW_XONXOFF
+    if ((c == XOFF) || (c == XON)) {
+        if ((c == XOFF) && !send_xoff) stops++;
+        send_xoff = (c == XOFF);
+        return;
+    }
+#endif
+
+    if (!echo_check) return;
+
+    if (echo_get == echo_put) {
+        fail("unexpected output");
+    }
+    else if (echo[echo_get++ % sizeof(echo)] != c) {
+        fail("echo mismatch");
+    }
+}
+
+/*
+ * The remote end's view of the stop request, FLOW_LAG ticks late.
+ */
+static uint8_t remote_stopped(void)
+{
+    uint8_t stop;
+
+#if CONSOLE_FLOW == CONSOLE_FLOW_XONXOFF
+    stop = send_xoff;
+#else
+    stop = (PORTD & _BV(RTS_BIT)) != 0;
+    if (stop && !send_stopped[FLOW_LAG - 1]) stops++;
+#endif
+
+    memmove(&send_stopped[1], &send_stopped[0], FLOW_LAG);
+    send_stopped[0] = stop;
+
+    return send_stopped[FLOW_LAG];
+}
+
+/*
+ * One byte from the remote end into the USART, or an overrun.
+ */
+static void line_in(uint8_t c)
+{
+    if (rx_fifo_count == sizeof(rx_fifo)) {
+        overruns++;
+        fail("receive overrun");
+        return;
+    }
+
+    rx_fifo[rx_fifo_count++] = c;
+}
+
+static void remote_send(void)
+{
+    uint8_t c;
+
+    /* stop or resume our transmitter, flow control bytes are never held */
+    if (!holding && hold_random && (random8() == 0) && (random8() < 64)) {
+        holding = 1;
+        hold_until = now + random8();
+        hold_char = XOFF;
+    }
+    else if (holding && (now >= hold_until)) {
+        holding = 0;
+        hold_char = XON;
+    }
+
+#if CONSOLE_FLOW == CONSOLE_FLOW_XONXOFF
+    if (hold_char) {
+        line_in(hold_char);
+        hold_char = 0;
+        return;
+    }
+#else
+    if (hold_char) {
+        if (hold_char == XOFF) PIND |= _BV(CTS_BIT);
+        else PIND &= ~_BV(CTS_BIT);
+        PCINT2_vect();
+        hold_char = 0;
+    }
+#endif
+
+    send_view = remote_stopped();
+
+    if (send_view) return;
+
+    if (send_fill) {
+        /*
+         * Directed test, a short line so the receiver may stop, a partial
+         * line then a kill while stopping.
+         */
+        if (send_fill < sizeof(fill_line)) {
+            line_in(fill_line[send_fill++ - 1]);
+        }
+        else if (send_stopped[0]) {
+            line_in(KILL);
+            send_fill = 0;
+        }
+        else {
+            line_in('x');
+        }
+        return;
+    }
+
+    if (!send_len || (lines_sent >= LINES)) return;
+
+    c = send_line[send_pos++];
+
+    line_in(c);
+    echo_expect(c);
+    sent_bytes++;
+
+    if (send_pos == send_len) {
+        if (pending_count == PENDING) {
+            fail("pending lines overflow");
+        }
+        else {
+            strcpy(pending[(pending_get + pending_count++) % PENDING],
+                   send_line);
+        }
+
+        lines_sent++;
+        next_line();
+    }
+}
+
+/*
+ * One byte time.
+ */
+static void tick(void)
+{
+    now++;
+
+    remote_send();
+
+    /* receive interrupt for each byte held by the USART */
+    while (rx_fifo_count && (UCSR0B & _BV(RXCIE0))) {
+        UDR0 = rx_fifo[0];
+        UCSR0A = 0;
+        rx_fifo[0] = rx_fifo[1];
+        rx_fifo_count--;
+        USART_RX_vect();
+    }
+
+    /* the byte sent last tick is complete */
+    if (tx_busy) {
+        tx_busy = 0;
+        if (!(UCSR0B & _BV(UDRIE0)) && (UCSR0B & _BV(TXCIE0))) {
+            USART_TX_vect();
+        }
+    }
+
+    if ((UCSR0B & _BV(TXEN0)) && (UCSR0B & _BV(UDRIE0))) {
+        UDR0 = UDR0_EMPTY;
+        USART_UDRE_vect();
+
+        if (UDR0 != UDR0_EMPTY) {
+            remote_receive(UDR0);
+            tx_busy = 1;
+        }
+    }
+}
+
+void sim_sleep(void)
+{
+    tick();
+}
+
+static void main_loop(void)
+{
+    struct console_line line;
+    char text[MAX_LINE + 2];
+    int16_t len;
+
+    if (now < busy_until) return;
+
+    len = console_readline(&line);
+
+    if (len < 0) return;
+
+    memcpy(text, line.ptr[0], line.len[0]);
+    memcpy(text + line.len[0], line.ptr[1], line.len[1]);
+    text[len] = '\0';
+
+    console_consume(len);
+
+    if (!pending_count) {
+        fail("line not sent");
+    }
+    else if (strcmp(text, pending[pending_get]) != 0) {
+        fail("line mismatch");
+    }
+
+    pending_get = (pending_get + 1) % PENDING;
+    pending_count--;
+    lines_read++;
+
+    busy_until = now + random8() % MAX_BUSY;
+}
+
+/*
+ * Directed: a frame is started, then an echoed character is erased and the
+ * receive ring-buffer filled past the high water mark.  The frame must go out
+ * back to back between its delimiters, the BS-SP-BS erase echo and the XOFF
+ * only after it.
+ */
+static void frame_test(void)
+{
+    static uint8_t frame[48];
+    static char const text[] = "ab\nz";
+    uint8_t const * p;
+    unsigned i;
+
+    /* frame bytes include XON and XOFF, only the delimiters are zero */
+    frame[0] = 0x00;
+    for (i = 1; i < sizeof(frame) - 1; i++) frame[i] = XON + i % 3;
+    frame[sizeof(frame) - 1] = 0x00;
+
+    echo_check = 0;
+    busy_until = UINT32_MAX;
+    send_len = 0;
+
+    /* a complete line so the receiver may stop, then an echoed character */
+    for (i = 0; i < sizeof(text) - 1; i++) {
+        line_in(text[i]);
+        tick();
+    }
+    while (UCSR0B & _BV(TXEN0)) tick();
+
+    capturing = 1;
+    console_frame(frame, sizeof(frame));
+    tick();
+    tick();
+
+    /* erase mid-frame, then fill to the high water mark */
+    line_in(ERASE);
+    tick();
+    for (i = 0; i < 32; i++) {
+        line_in('x');
+        tick();
+    }
+
+    for (i = 0; console_frame_busy() || (UCSR0B & _BV(TXEN0)); i++) {
+        if (i > 1000) {
+            fail("frame not sent");
+            break;
+        }
+        tick();
+    }
+
+    if ((capture_len < sizeof(frame)) ||
+        memcmp(capture, frame, sizeof(frame)) != 0) {
+        fail("frame interrupted");
+    }
+
+    p = memchr(capture + sizeof(frame), ERASE, capture_len - sizeof(frame));
+    if (!p || (capture + capture_len - p < 3) || memcmp(p, "\b \b", 3)) {
+        fail("erase echo missing after frame");
+    }
+
+#if CONSOLE_FLOW == CONSOLE_FLOW_XONXOFF
+    if (!memchr(capture + sizeof(frame), XOFF, capture_len - sizeof(frame))) {
+        fail("XOFF missing after frame");
+    }
+#endif
+
+    printf("console: %u byte frame sent whole, %u bytes after it\n",
+           (unsigned) sizeof(frame), capture_len - (unsigned) sizeof(frame));
+}
+
+/*
+ * Bytes from the remote end, given time to be received and echoed.
+ */
+static void text_in(char const * text)
+{
+    unsigned i;
+
+    while (*text) {
+        line_in(*text++);
+        tick();
+    }
+
+    for (i = 0; i < 50; i++) tick();
+}
+
+/*
+ * Directed: the main loop wake event.  CONSOLE_EV_RX is raised for a
+ * complete line but not part of one, and console_consume raises it again
+ * while another line remains.
+ */
+static void event_test(void)
+{
+    static char const kill[] = { KILL, '\0' };
+    struct console_line line;
+    int16_t len;
+
+    /* our transmitter runs free so each line is echoed */
+    hold_random = 0;
+    while (holding || hold_char) tick();
+
+    /* drop the partial line and anything left by the last test */
+    text_in(kill);
+    while ((len = console_readline(&line)) >= 0) console_consume(len);
+
+    GPIOR0 = 0;
+    text_in("a");
+    if (GPIOR0 & CONSOLE_EV_RX) fail("wake event for part of a line");
+
+    text_in("b\n");
+    if (!(GPIOR0 & CONSOLE_EV_RX)) fail("no wake event for a line");
+
+    text_in("c\n");
+    GPIOR0 = 0;
+
+    len = console_readline(&line);
+    if (len != 3) fail("first line not read");
+    console_consume(len);
+    if (!(GPIOR0 & CONSOLE_EV_RX)) fail("no wake event for the next line");
+
+    GPIOR0 = 0;
+    len = console_readline(&line);
+    if (len != 2) fail("second line not read");
+    console_consume(len);
+    if (GPIOR0 & CONSOLE_EV_RX) fail("wake event with no input left");
+
+    printf("console: wake event on lines and after consume\n");
+}
+
+int main(void)
+{
+    struct console_stats stats;
+    uint32_t start;
+
+    srand(1);
+
+    console_setattr(console_getattr() | ECHO | INONBLOCK);
+
+    next_line();
+
+    while (lines_read < LINES) {
+        tick();
+        main_loop();
+
+        if (now > 100 * LINES * MAX_LINE) {
+            fail("stalled");
+            break;
+        }
+    }
+
+    console_get_stats(&stats);
+
+    printf("console: %lu lines, %lu bytes in %u byte times, %u%% of line "
+           "rate, %lu stops\n", lines_read, sent_bytes, now,
+           (unsigned) (100ULL * sent_bytes / now), stops);
+    printf("console: receive high %u of %u, dropped %u, overrun %lu\n",
+           stats.rx_high, 32, stats.rx_dropped, overruns);
+
+    if (stats.rx_dropped) fail("bytes dropped");
+
+    /*
+     * Directed: behind a short line, a partial line past the high water mark
+     * is killed.  No line is consumed, the kill alone must resume the sender.
+     */
+    while (holding || hold_char) tick();
+    echo_check = 0;
+    busy_until = UINT32_MAX;
+    send_len = 0;
+    send_fill = 1;
+
+    start = now;
+
+    while (send_fill) {
+        tick();
+
+        if (now - start > 1000) {
+            fail("sender not stopped");
+            break;
+        }
+    }
+
+    /* the sender sees the stop FLOW_LAG ticks late */
+    while (!send_view && (now - start < 1000)) tick();
+
+    start = now;
+
+    do {
+        tick();
+
+        if (now - start > 1000) {
+            fail("sender not resumed after kill");
+            break;
+        }
+    } while (send_view);
+
+    printf("console: sender resumed %u byte times after kill\n", now - start);
+
+    /* transmitter turns off once idle */
+    start = now;
+    while ((UCSR0B & _BV(TXEN0)) && (now - start < 1000)) tick();
+    if (UCSR0B & _BV(TXEN0)) fail("transmitter left on");
+
+    frame_test();
+    event_test();
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test of the held key auto-repeat in keyrep.c.
+ *
+ *  keyrep.c is built against the register simulation in host/sim and fed
+ *  key scans directly, times are in timebase ticks.  Each scan is checked
+ *  against a reference where repeat i after a press at t comes at
+ *
+ *      t + delay + gap(0) + ... + gap(i - 1)
+ *      gap(j) = max(interval >> (j / accel), min), interval for j < accel
+ *
+ *   - The defaults are 500, 100 and 10 ms and 5 repeats per halving.
+ *   - A directed hold repeats at the times the formula gives.
+ *   - A scan late by more than 255 repeats returns 255 and repeats resume
+ *     one interval after it.
+ *   - A delay of 0 never repeats.
+ *   - A release, or another key, stops the repeat.  A new press of a
+ *     repeating key restarts it with all the repeating keys held.
+ *   - Random holds with random timing and scan rates, some across the
+ *     timebase wrap, match the reference scan by scan.
+ *
+ *      make -C host test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "keyrep.h"
+
+/* as main.c, the pulse width step keys repeat */
+#define MASK  (0x22220000UL | 0x00002222UL)
+#define KEY_A (0x00000002UL)
+#define KEY_B (0x00020000UL)
+#define OTHER (0x00000004UL)
+
+/* as timer.h, 16 MHz and a clk/256 timebase */
+#define TBTICKS_FROM_MS(m) ((uint32_t) ((16000000UL / 256) * (m) / 1000))
+
+#ifndef HOLDS
+#define HOLDS (100000UL)
+#endif
+
+/* reference state */
+static struct keyrep_params ref_params;
+static uint32_t ref_keys;
+static uint32_t ref_next;
+static unsigned long ref_index;
+
+static unsigned long repeats;
+static unsigned long checks;
+static unsigned long errors;
+
+static void check(int ok, char const * what)
+{
+    checks++;
+    if (!ok && (errors++ < 10)) fprintf(stderr, "keyrep: %s\n", what);
+}
+
+static void params(uint32_t delay, uint32_t interval, uint32_t min,
+                   uint8_t accel)
+{
+    ref_params.delay = delay;
+    ref_params.interval = interval;
+    ref_params.min = min;
+    ref_params.accel = accel;
+
+    keyrep_set_params(&ref_params);
+}
+
+static uint32_t gap(unsigned long j)
+{
+    unsigned long const halvings = ref_params.accel ? j / ref_params.accel : 0;
+    uint32_t g;
+
+    if (!halvings) return ref_params.interval;
+
+    g = (halvings < 32) ? ref_params.interval >> halvings : 0;
+
+    return (g > ref_params.min) ? g : ref_params.min;
+}
+
+static unsigned ref_scan(uint32_t keys, uint32_t keys_down, uint32_t now)
+{
+    unsigned n = 0;
+
+    if (keys_down & MASK) {
+        ref_keys = keys & MASK;
+        ref_next = now + ref_params.delay;
+        ref_index = 0;
+        return 0;
+    }
+
+    if (!ref_params.delay || !ref_keys || (keys != ref_keys)) {
+        ref_keys = 0;
+        return 0;
+    }
+
+    while ((int32_t) (now - ref_next) >= 0) {
+        /* too far behind, the rest are dropped */
+        if (++n == 255) ref_next = now;
+        ref_next += gap(ref_index++);
+    }
+
+    return n;
+}
+
+/*
+ * One scan, keyrep against the reference.
+ */
+static unsigned scan(uint32_t keys, uint32_t keys_down, uint32_t now)
+{
+    unsigned const n = keyrep_scan(keys, keys_down, now);
+
+    check(n == ref_scan(keys, keys_down, now), "repeats differ");
+    check(keyrep_keys() == ref_keys, "repeating keys differ");
+
+    repeats += n;
+
+    return n;
+}
+
+static void test_defaults(void)
+{
+    struct keyrep_params kp;
+
+    keyrep_get_params(&kp);
+
+    check(kp.delay == TBTICKS_FROM_MS(500), "default delay");
+    check(kp.interval == TBTICKS_FROM_MS(100), "default interval");
+    check(kp.min == TBTICKS_FROM_MS(10), "default min");
+    check(kp.accel == 5, "default accel");
+}
+
+static void test_directed(void)
+{
+    static uint32_t const at[] = {
+        100, 140, 180, 200, 220, 230, 240, 245, 250, 255, 260
+    };
+    uint32_t t;
+    unsigned i = 0;
+
+    params(100, 40, 5, 2);
+
+    scan(KEY_A, KEY_A, 0);
+
+    for (t = 1; t <= 260; t++) {
+        if (scan(KEY_A, 0, t)) {
+            check((i < sizeof(at) / sizeof(at[0])) && (t == at[i]),
+                  "repeat off time");
+            i++;
+        }
+    }
+
+    check(i == sizeof(at) / sizeof(at[0]), "repeat count");
+
+    /* 255 at most, then one interval on */
+    params(10, 1, 1, 0);
+
+    scan(KEY_A, KEY_A, 1000);
+    check(scan(KEY_A, 0, 100000) == 255, "late scan not capped");
+    check(scan(KEY_A, 0, 100000) == 0, "repeat left after the cap");
+    check(scan(KEY_A, 0, 100001) == 1, "no repeat after the cap");
+
+    /* off */
+    params(0, 10, 1, 0);
+
+    scan(KEY_A, KEY_A, 0);
+    for (t = 1; t < 1000; t++) {
+        check(scan(KEY_A, 0, t) == 0, "repeat with delay 0");
+    }
+    check(keyrep_keys() == 0, "keys left with delay 0");
+
+    /* release, another key, a second repeating key */
+    params(10, 10, 10, 0);
+
+    scan(KEY_A, KEY_A, 0);
+    scan(KEY_A, 0, 10);
+    check(scan(0, 0, 20) == 0 && !keyrep_keys(), "repeat after release");
+
+    scan(KEY_A, KEY_A, 100);
+    scan(KEY_A, 0, 110);
+    check(scan(KEY_A | OTHER, OTHER, 120) == 0 && !keyrep_keys(),
+          "repeat with another key");
+
+    scan(KEY_A, KEY_A, 200);
+    check(scan(KEY_A | KEY_B, KEY_B, 205) == 0, "repeat on a new press");
+    check(keyrep_keys() == (KEY_A | KEY_B), "second key not repeating");
+    check(scan(KEY_A | KEY_B, 0, 214) == 0, "press did not restart");
+    check(scan(KEY_A | KEY_B, 0, 215) == 1, "both keys did not repeat");
+}
+
+static uint32_t random32(void)
+{
+    return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+}
+
+static void test_random(void)
+{
+    unsigned long h;
+
+    for (h = 0; h < HOLDS; h++) {
+        uint32_t const key = (rand() & 1) ? KEY_A : KEY_B;
+        uint32_t now;
+        unsigned s, scans;
+
+        params(rand() % 8 ? 1 + rand() % 1000 : 0, 1 + rand() % 500,
+               1 + rand() % 50, rand() % 10);
+
+        /* some holds start just before the timebase wraps */
+        now = (rand() % 4) ? random32() : -(uint32_t) (rand() % 5000);
+
+        scan(key, key, now);
+
+        scans = rand() % 200;
+        for (s = 0; s < scans; s++) {
+            now += (rand() % 16) ? 1 + rand() % 50 : rand() % 100000;
+            scan(key, 0, now);
+        }
+
+        scan(0, 0, now + 1);
+    }
+}
+
+int main(void)
+{
+    srand(1);
+
+    keyrep_init(MASK);
+
+    test_defaults();
+    test_directed();
+    test_random();
+
+    printf("keyrep: %lu holds, %lu repeats\n", HOLDS, repeats);
+    printf("keyrep: %lu checks, %lu errors\n", checks, errors);
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test for the log lanes in log.c.
+ *
+ *  log.c is built against stand-in console output functions with a random
+ *  amount of transmit room.  Random messages are logged at a priority and a
+ *  bulk level, some are queued and some dropped, and the lanes are drained at
+ *  random.  Each message carries its lane, length and sequence number, every
+ *  message not counted as dropped must reach the console whole, and in order
+ *  within its lane, including those that wrap a lane.
+ *
+ *      make -C host test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+
+#define MESSAGES (200000UL)
+#define MAX_MSG  (30)
+
+static uint8_t out[1UL << 23];
+static size_t out_len;
+static size_t room;
+
+/* next sequence number expected from each lane, and the ones dropped */
+static uint32_t next_seq[2];
+static uint8_t dropped_seq[2][MESSAGES];
+
+int console_write(void const * buf, size_t len)
+{
+    memcpy(out + out_len, buf, len);
+    out_len += len;
+
+    return 0;
+}
+
+int8_t console_trywrite(void const * buf, size_t len)
+{
+    if (len > room) return -1;
+
+    console_write(buf, len);
+    room -= len;
+
+    return 0;
+}
+
+size_t console_tx_room(void)
+{
+    return room;
+}
+
+/*
+ * Message: lane, length, 32-bit sequence number, then a fill derived from
+ * the sequence number.
+ */
+static uint8_t message(uint8_t * msg, uint8_t lane, uint32_t seq)
+{
+    uint8_t const len = 6 + rand() % (MAX_MSG - 6);
+
+    msg[0] = lane;
+    msg[1] = len;
+    memcpy(&msg[2], &seq, sizeof(seq));
+    for (uint8_t i = 6; i < len; i++) msg[i] = seq + i;
+
+    return len;
+}
+
+int main(void)
+{
+    static uint32_t seq[2];
+    struct log_stats stats;
+    unsigned long errors = 0;
+    unsigned long count = 0;
+    unsigned long dropped_count = 0;
+    uint8_t msg[MAX_MSG];
+    size_t i;
+
+    srand(1);
+
+    log_init();
+    log_set_level(LOG_DEBUG);
+    log_set_policy(LOG_INFO, LOG_DROP_NEWEST);
+    log_set_policy(LOG_ERR, LOG_DROP_NEWEST);
+
+    for (i = 0; i < MESSAGES; i++) {
+        uint8_t const lane = rand() & 1;
+        uint8_t const len = message(msg, lane, seq[lane]);
+        uint16_t dropped;
+
+        room += rand() % 24;
+
+        log_get_stats(&stats);
+        dropped = stats.dropped;
+
+        log_write(lane ? LOG_ERR : LOG_INFO, msg, len);
+
+        log_get_stats(&stats);
+        if (stats.dropped != dropped) {
+            dropped_seq[lane][seq[lane]] = 1;
+            dropped_count++;
+        }
+        seq[lane]++;
+
+        if (!(rand() % 4)) log_poll();
+    }
+
+    room = SIZE_MAX;
+    log_poll();
+
+    /*
+     * Walk the output, each message must be whole and the next one kept by
+     * its lane.
+     */
+    for (i = 0; (i + 6 <= out_len) && (errors < 10); i += out[i + 1]) {
+        uint8_t const lane = out[i];
+        uint32_t s;
+
+        memcpy(&s, &out[i + 2], sizeof(s));
+
+        while ((lane < 2) && (next_seq[lane] < seq[lane]) &&
+               dropped_seq[lane][next_seq[lane]]) next_seq[lane]++;
+
+        if ((lane > 1) || (out[i + 1] < 6) || (s != next_seq[lane])) {
+            fprintf(stderr, "log: byte %lu: message out of order\n",
+                    (unsigned long) i);
+            errors++;
+            break;
+        }
+
+        for (uint8_t j = 6; j < out[i + 1]; j++) {
+            if (out[i + j] != (uint8_t) (s + j)) {
+                fprintf(stderr, "log: byte %lu: message torn\n",
+                        (unsigned long) i);
+                errors++;
+                break;
+            }
+        }
+
+        next_seq[lane]++;
+        count++;
+    }
+
+    for (uint8_t lane = 0; lane < 2; lane++) {
+        while ((next_seq[lane] < seq[lane]) &&
+               dropped_seq[lane][next_seq[lane]]) next_seq[lane]++;
+
+        if (!errors && (next_seq[lane] != seq[lane])) {
+            fprintf(stderr, "log: lane %u: messages lost\n", lane);
+            errors++;
+        }
+    }
+
+    printf("log: %lu messages, %lu written, %lu dropped, %lu bytes\n",
+           MESSAGES, count, dropped_count, (unsigned long) out_len);
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test of the PID control step in pid.c.
+ *
+ *  pid.c is built against the register simulation in host/sim.  The test
+ *  stands in for the timebase and the timer event list, runs each step when
+ *  it falls due, and closes the loop through a simulated servo, a first
+ *  order lag from the pulse width to an ADC reading.
+ *
+ *   - P+I settles on a reachable setpoint with no steady state error.
+ *   - A setpoint past the output limit holds the output at the limit, and
+ *     the integral does not wind up, a reachable setpoint leaves the limit
+ *     at once and settles.
+ *   - A setpoint step with derivative only does not move the output, a
+ *     feedback step does, by kd times the change.
+ *   - The first step after pid_enable has no derivative kick from feedback
+ *     left over from before.
+ *   - A conversion still running keeps the last feedback.
+ *   - PID_HZ steps take exactly one second of timebase ticks, a late step
+ *     counts an overrun and skips ahead.
+ *
+ *      make -C host test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <avr/io.h>
+
+/* as project.h, the timebase is timer 0 compare A, feedback on ADC3 */
+#define TBTIMER 0
+#define TBTIMER_COMP A
+#define PID_ADC_CHANNEL (3)
+
+#include "timer.h"
+#include "pid.h"
+#include "servo.h"
+
+/* as pid.c, 16 MHz and a clk/256 timebase */
+#define TBTICK_HZ (16000000UL / 256)
+
+/* servo lag, the fraction of the remaining move made per step */
+#define LAG (0.05)
+
+/*
+ * Simulated registers.
+ */
+volatile uint8_t ADMUX, ADCSRA, DIDR0;
+volatile uint16_t ADC;
+
+/* the ADC reading follows the servo unless held */
+static uint8_t adc_hold;
+
+static uint32_t now;
+static struct timer_event * event;
+
+static double servo_us = 1500.0;
+static uint16_t servo_cmd;
+static unsigned long servo_writes;
+
+static unsigned long checks;
+static unsigned long errors;
+
+static void check(int ok, char const * what)
+{
+    checks++;
+    if (!ok && (errors++ < 10)) fprintf(stderr, "pid: %s\n", what);
+}
+
+/*
+ * Timebase and timer event stand-ins, an event is active while its next
+ * pointer is not itself.
+ */
+uint32_t tbtick_update(void)
+{
+    return now;
+}
+
+void schedule_timer_event(struct timer_event * this_timer_event,
+                          struct timer_event * ref_timer_event)
+{
+    (void) ref_timer_event;
+
+    this_timer_event->next = NULL;
+    event = this_timer_event;
+}
+
+void cancel_timer_event(struct timer_event * this_timer_event)
+{
+    this_timer_event->next = this_timer_event;
+}
+
+void servo_set(uint16_t pulse_us)
+{
+    servo_cmd = pulse_us;
+    servo_writes++;
+}
+
+/*
+ * Servo position as an ADC reading, 0 at SERVO_MIN_PULSE and 1023 at
+ * SERVO_MAX_PULSE.
+ */
+static uint16_t adc_from_us(double us)
+{
+    double const adc = (us - SERVO_MIN_PULSE) * 1023.0
+                     / (SERVO_MAX_PULSE - SERVO_MIN_PULSE);
+
+    return (adc < 0) ? 0 : (adc > 1023) ? 1023 : (uint16_t) (adc + 0.5);
+}
+
+/*
+ * One control step when it is due, the conversion it reads is complete.
+ */
+static void step(void)
+{
+    now = event->tbtick;
+
+    if (!adc_hold) ADC = adc_from_us(servo_us);
+    ADCSRA &= ~_BV(ADSC);
+
+    if (event->handler(event)) event->next = NULL;
+    else event->next = event;
+
+    if (servo_cmd) servo_us += (servo_cmd - servo_us) * LAG;
+}
+
+static void run(unsigned long steps)
+{
+    while (steps--) step();
+}
+
+static void test_settle(void)
+{
+    pid_limits(SERVO_MIN_PULSE, SERVO_MAX_PULSE);
+    pid_gains(1 << PID_FRAC, 13, 0);
+    pid_setpoint(700);
+    pid_enable(1);
+
+    run(5000);
+
+    check(abs((int) pid_feedback() - 700) <= 1, "P+I did not settle");
+    check(abs((int) servo_cmd - 1868) <= 2, "P+I output off");
+}
+
+static void test_windup(void)
+{
+    unsigned long n;
+
+    /* 1000 to 2000 us reads at most 767, the setpoint is out of reach */
+    pid_limits(1000, 2000);
+    pid_setpoint(1023);
+
+    run(2000);
+
+    check(pid_output() == 2000, "output not held at the limit");
+
+    pid_setpoint(700);
+    step();
+    step();
+
+    check(pid_output() < 2000, "output held at the limit, integral wound up");
+
+    for (n = 0; (n < 5000) && (abs((int) pid_feedback() - 700) > 1); n++) {
+        step();
+    }
+
+    check(n < 5000, "did not settle after the limit");
+}
+
+static void test_derivative(void)
+{
+    uint16_t out;
+
+    pid_limits(SERVO_MIN_PULSE, SERVO_MAX_PULSE);
+    pid_gains(0, 0, 4 << PID_FRAC);
+    adc_hold = 1;
+    ADC = 400;
+    run(10);
+
+    out = pid_output();
+    check(out == 1500, "derivative only output not centred");
+
+    pid_setpoint(900);
+    run(1);
+    check(pid_output() == out, "setpoint step kicked the output");
+
+    ADC = 410;
+    run(1);
+    check(pid_output() == out - 40, "feedback step not kd times the change");
+
+    run(1);
+    check(pid_output() == out, "derivative did not return");
+
+    /* feedback left from before enable must not kick the first step */
+    pid_enable(0);
+    ADC = 900;
+    pid_enable(1);
+    run(1);
+    check(pid_output() == out, "first step after enable kicked");
+
+    /* a conversion still running keeps the last feedback */
+    ADC = 100;
+    now = event->tbtick;
+    ADCSRA |= _BV(ADSC);
+    event->handler(event);
+    check(pid_feedback() == 900, "read a conversion still running");
+
+    adc_hold = 0;
+    pid_enable(0);
+}
+
+static void test_timing(void)
+{
+    struct pid_stats stats;
+    uint32_t start;
+
+    pid_gains(1 << PID_FRAC, 0, 0);
+    pid_enable(1);
+    pid_clear_stats();
+
+    start = event->tbtick;
+    run(PID_HZ);
+    check(event->tbtick - start == TBTICK_HZ, "PID_HZ steps not one second");
+
+    pid_get_stats(&stats);
+    check(stats.steps == PID_HZ, "step count");
+    check(stats.overruns == 0, "overrun on time");
+
+    /* the step runs two periods late, the one due meanwhile is skipped */
+    now = event->tbtick + 2 * (TBTICK_HZ / PID_HZ);
+    start = now;
+    event->handler(event);
+
+    pid_get_stats(&stats);
+    check(stats.overruns == 1, "late step not an overrun");
+    check(event->tbtick == start + TBTICK_HZ / PID_HZ, "overrun not skipped");
+    check(stats.max_late >= 2 * (TBTICK_HZ / PID_HZ), "max_late");
+
+    pid_enable(0);
+}
+
+int main(void)
+{
+    pid_init();
+
+    check(ADMUX == (_BV(REFS0) | PID_ADC_CHANNEL), "ADMUX");
+    check(ADCSRA & _BV(ADSC), "no first conversion");
+
+    test_settle();
+    test_windup();
+    test_derivative();
+    test_timing();
+
+    printf("pid: %lu checks, %lu errors, %lu servo writes\n", checks,
+           errors, servo_writes);
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,494 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test of the servo motion profile and software channels in servo.c.
+ *
+ *  servo.c is built against the register simulation in host/sim.  For the
+ *  motion profile the test runs the timer 1 overflow interrupt once per
+ *  frame and reads the pulse width back from OCR1A, in counts of 0.5 us.
+ *
+ *   - A trapezoid move keeps to the velocity and acceleration limits, ends
+ *     exactly on the target and takes the time the limits allow, within a
+ *     few frames.
+ *   - An S-curve move also keeps the change in acceleration to the jerk
+ *     limit, and takes the ramp frames longer.
+ *   - Random moves, with random limits and new targets while moving, keep to
+ *     the limits and settle on the last target, with servo_busy clear and
+ *     servo_position reading the target.
+ *   - Moves to and from off jump.
+ *   - Every width from SERVO_MIN_PULSE to SERVO_MAX_PULSE scales to exactly
+ *     2 counts per us on OC1A and OC1B, and servo_position reads it back.
+ *
+ *  For the software channels the test runs timers 1 and 2 count by count.
+ *  Each TCNT1 read takes a count, about the poll loop, and each interrupt is
+ *  entered 4 to 6 counts after it is due, the latency servo.h allows for.
+ *
+ *   - Random widths set at random times, some shared and some close
+ *     together, take effect at the next frame.  Each pulse is as wide as
+ *     set, from the rise to the fall seen on the port, and at most a count
+ *     longer.  Channels that are off never rise.
+ *   - OC1B is written to its compare register.
+ *
+ *      make -C host test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <avr/io.h>
+
+#include "servo.h"
+
+/* as servo.c, 100 Hz frames of 20000 counts */
+#define FRAME_HZ    (100)
+#define PWM_COUNTS  (20000)
+#define PWM_TOP     (PWM_COUNTS - 1)
+
+/* timer 2 at clk/32 ticks every 4 timer 1 counts at clk/8 */
+#define TICK_COUNTS (4)
+
+/* as project.h, channels 2 and up on D5, D7, D8, A0, A1 and A2 */
+#define SERVO_CHANNELS (8)
+#define SOFT        (SERVO_CHANNELS - 2)
+
+#define MOVES       (20000UL)
+#define FRAMES      (20000UL)
+
+/*
+ * Simulated registers.
+ */
+volatile uint8_t PINB, PINC, PIND, PORTB, PORTC, PORTD, DDRB, DDRC, DDRD;
+volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIFR1, TIMSK1;
+volatile uint16_t ICR1, OCR1A, OCR1B;
+volatile uint8_t TCNT2, OCR2A, TIFR2, TIMSK2;
+
+extern void TIMER1_OVF_vect(void);
+extern void TIMER2_COMPA_vect(void);
+
+static volatile uint8_t * const soft_port[SOFT] = {
+    &PORTD, &PORTD, &PORTB, &PORTC, &PORTC, &PORTC
+};
+static uint8_t const soft_bit[SOFT] = { 5, 7, 0, 0, 1, 2 };
+
+/* simulated time in timer 1 counts, and the interrupt flags */
+static unsigned long long now;
+static uint8_t tov1;
+static uint8_t ocf2a;
+
+/* soft channel widths set, applied at the frame start, and as seen */
+static uint16_t soft_set[SOFT];
+static uint16_t soft_frame[SOFT];
+static uint8_t soft_high[SOFT];
+static unsigned long long soft_rise[SOFT];
+static unsigned long pulses;
+static unsigned long late[2];
+
+/* limits in counts per frame, and S-curve ramp frames */
+static double max_v;
+static double max_a;
+static double max_j;
+static unsigned ramp;
+
+/* the last three outputs and acceleration, for the jerk */
+static long out[3];
+static long a_last;
+
+static unsigned long frames;
+static unsigned long checks;
+static unsigned long errors;
+
+static void check(int ok, char const * what)
+{
+    checks++;
+    if (!ok && (errors++ < 10)) fprintf(stderr, "servo: %s\n", what);
+}
+
+static long counts(void)
+{
+    return PWM_TOP - OCR1A;
+}
+
+static void limits(uint16_t velocity_us, uint32_t accel_us, uint32_t jerk_us)
+{
+    servo_limits(velocity_us, accel_us, jerk_us);
+
+    max_v = velocity_us * 2.0 / FRAME_HZ;
+    max_a = accel_us * 2.0 / (FRAME_HZ * FRAME_HZ);
+    max_j = jerk_us * 2.0 / (FRAME_HZ * FRAME_HZ * FRAME_HZ);
+
+    /* ramp frames, 2 accel / jerk up to a power of two, at most 16 */
+    ramp = 1;
+    if (jerk_us) {
+        while ((ramp < 16) && (ramp * max_j < 2 * max_a)) ramp *= 2;
+
+        /* a jerk too low for 16 frames gets what 16 frames give */
+        if (max_j < 2 * max_a / 16) max_j = 2 * max_a / 16;
+    }
+}
+
+/*
+ * Start tracking from a still output.
+ */
+static void hold(void)
+{
+    out[0] = out[1] = out[2] = counts();
+    a_last = 0;
+}
+
+/*
+ * One frame, the output is checked against the limits, the output rounds
+ * down to a count so each difference may be off by its rounding.
+ */
+static void frame(void)
+{
+    long v0, v1, a0, a1;
+
+    TIMER1_OVF_vect();
+    frames++;
+
+    out[2] = out[1];
+    out[1] = out[0];
+    out[0] = counts();
+
+    v0 = out[0] - out[1];
+    v1 = out[1] - out[2];
+    a0 = v0 - v1;
+
+    check(labs(v0) <= max_v + 1, "velocity over the limit");
+    check(labs(a0) <= max_a + 2, "acceleration over the limit");
+
+    a1 = a_last;
+    a_last = a0;
+
+    if (ramp > 1) {
+        check(labs(a0 - a1) <= max_j + 4, "jerk over the limit");
+    }
+}
+
+/*
+ * Frames until the move is done, at most limit.
+ */
+static unsigned long settle(unsigned long limit)
+{
+    unsigned long n = 0;
+
+    while (servo_busy() && (n < limit)) {
+        frame();
+        n++;
+    }
+
+    return n;
+}
+
+/*
+ * Frames a move of d counts takes at the limits, with the first frame of
+ * acceleration and the ramp frames.
+ */
+static double move_frames(double d)
+{
+    double t;
+
+    if (d >= max_v * max_v / max_a) t = d / max_v + max_v / max_a;
+    else t = 2 * sqrt(d / max_a);
+
+    return t + ramp - 1;
+}
+
+static void test_move(uint16_t velocity_us, uint32_t accel_us,
+                      uint32_t jerk_us, uint16_t from_us, uint16_t to_us)
+{
+    double const d = 2.0 * abs((int) to_us - (int) from_us);
+    unsigned long n;
+    double t;
+
+    limits(velocity_us, accel_us, jerk_us);
+    servo_set(from_us);
+    hold();
+
+    servo_move(to_us);
+    check(servo_busy(), "not moving");
+
+    n = settle(100000UL);
+    t = move_frames(d);
+
+    check(counts() == 2 * to_us, "move did not end on the target");
+    check(servo_position() == to_us, "position not the target");
+    if ((n < t - 1) || (n > t + 3)) {
+        fprintf(stderr, "servo: %u to %u us at %u us/s %lu us/s^2 %lu us/s^3 "
+                "took %lu frames, expected %.1f\n", from_us, to_us,
+                velocity_us, (unsigned long) accel_us,
+                (unsigned long) jerk_us, n, t);
+        check(0, "move time");
+    } else {
+        check(1, "move time");
+    }
+}
+
+/*
+ * The fixed-point scaling against the exact 2 counts per us, both ways and
+ * on the hardware channels, over the whole range.
+ */
+static void test_scale(void)
+{
+    uint16_t us;
+
+    for (us = SERVO_MIN_PULSE; us <= SERVO_MAX_PULSE; us++) {
+        servo_set(us);
+        check(counts() == 2L * us, "servo_set not 2 counts per us");
+        check(servo_position() == us, "servo_position not the width set");
+
+        servo_pulse(1, us);
+        check(PWM_TOP - OCR1B == 2L * us, "OC1B not 2 counts per us");
+    }
+
+    servo_set(0);
+    servo_pulse(1, 0);
+    check(servo_position() == 0, "off position not 0");
+}
+
+static void test_off(void)
+{
+    limits(2000, 10000, 0);
+
+    servo_set(0);
+    check(OCR1A == PWM_TOP, "off not at TOP");
+
+    servo_move(1500);
+    check(!servo_busy() && (counts() == 3000), "from off did not jump");
+
+    servo_move(0);
+    check(!servo_busy() && (OCR1A == PWM_TOP), "to off did not jump");
+}
+
+/*
+ * Random moves, each interrupted by the next after a random number of
+ * frames, then settled.
+ */
+static void test_random(void)
+{
+    unsigned long n;
+    unsigned long interrupted = 0;
+
+    for (n = 0; n < MOVES; n++) {
+        uint16_t const velocity_us = 100 + rand() % (SERVO_MAX_VELOCITY - 99);
+        uint32_t const accel_us = 100 + rand() % (SERVO_MAX_ACCEL - 99);
+        uint32_t const jerk_us = (rand() % 2) ? 0 : 1 + rand() % 2000000;
+        uint16_t to_us = 0;
+        unsigned i;
+
+        limits(velocity_us, accel_us, jerk_us);
+        servo_set(SERVO_MIN_PULSE + rand() % 2001);
+        hold();
+
+        for (i = 0; i < 3; i++) {
+            to_us = SERVO_MIN_PULSE + rand() % 2001;
+            servo_move(to_us);
+
+            if (servo_busy() && (i < 2)) {
+                settle(rand() % 100);
+                interrupted += servo_busy();
+            }
+        }
+
+        settle(100000UL);
+
+        check(!servo_busy(), "random move did not settle");
+        check(counts() == 2 * to_us, "random move missed the target");
+        check(servo_position() == to_us, "random position not the target");
+    }
+
+    printf("servo: %lu random moves, %lu interrupted, %lu frames\n", n,
+           interrupted, frames);
+}
+
+/*
+ * One count of timer 1, and a tick of timer 2 every TICK_COUNTS.
+ */
+static void advance(unsigned n)
+{
+    while (n--) {
+        now++;
+
+        if (!(now % PWM_COUNTS)) tov1 = 1;
+
+        if (!(now % TICK_COUNTS) && (++TCNT2 == OCR2A)) ocf2a = 1;
+    }
+}
+
+/*
+ * Look at the soft channel pins, a change is taken as at this count.
+ */
+static void sample(void)
+{
+    unsigned i;
+
+    for (i = 0; i < SOFT; i++) {
+        uint8_t const high = (*soft_port[i] >> soft_bit[i]) & 1;
+
+        if (high == soft_high[i]) continue;
+
+        soft_high[i] = high;
+
+        if (high) {
+            soft_rise[i] = now;
+            check(soft_frame[i] != 0, "channel off rose");
+        } else {
+            long const over = (long) (now - soft_rise[i]) - soft_frame[i];
+
+            /* the fall is seen at the TCNT1 read after it, a count on */
+            check((over >= 1) && (over <= 2), "pulse width");
+            if ((over >= 1) && (over <= 2)) late[over - 1]++;
+            pulses++;
+        }
+    }
+}
+
+/*
+ * TCNT1 read, it takes a count.
+ */
+volatile uint16_t * sim_tcnt1(void)
+{
+    static volatile uint16_t tcnt1;
+
+    sample();
+    tcnt1 = now % PWM_COUNTS;
+    advance(1);
+
+    return &tcnt1;
+}
+
+/*
+ * Run until the count at, taking interrupts as they are due, timer 2
+ * compare A first as its vector is first.
+ */
+static void run_until(unsigned long long at)
+{
+    while (now < at) {
+        uint8_t const compa = ocf2a && (TIMSK2 & _BV(OCIE2A));
+        uint8_t const ovf = tov1 && (TIMSK1 & _BV(TOIE1));
+        unsigned i;
+
+        if (!compa && !ovf) {
+            advance(1);
+            continue;
+        }
+
+        advance(4 + rand() % 3);
+
+        if (compa) {
+            ocf2a = 0;
+            TIMER2_COMPA_vect();
+        } else {
+            tov1 = 0;
+
+            /* the widths set so far start this frame, all were low */
+            for (i = 0; i < SOFT; i++) {
+                check(!soft_high[i], "channel high at the frame start");
+                soft_frame[i] = soft_set[i];
+            }
+
+            TIMER1_OVF_vect();
+        }
+
+        /* TIFR2 is cleared by writing a one */
+        if (TIFR2 & _BV(OCF2A)) ocf2a = 0;
+        TIFR2 = 0;
+
+        sample();
+    }
+}
+
+/*
+ * Random soft channel widths, set at random times in the frame, often the
+ * same as or close to another channel.
+ */
+static void test_soft(void)
+{
+    unsigned long n;
+
+    servo_pulse(1, 1234);
+    check(OCR1B == PWM_TOP - 2468, "OC1B");
+
+    for (n = 0; n < FRAMES; n++) {
+        unsigned const changes = rand() % 3;
+        unsigned i;
+
+        for (i = 0; i < changes; i++) {
+            uint8_t const ch = rand() % SOFT;
+            uint16_t us;
+
+            switch (rand() % 4) {
+            case 0:
+                us = 0;
+                break;
+            case 1:
+                /* the same as, or a count or few from, another channel */
+                us = soft_set[rand() % SOFT] / 2;
+                if (!us) us = SERVO_MIN_PULSE;
+                us += rand() % 3;
+                break;
+            default:
+                us = SERVO_MIN_PULSE + rand() % 2001;
+                break;
+            }
+
+            if (us > SERVO_MAX_PULSE) us = SERVO_MAX_PULSE;
+
+            run_until(now + rand() % PWM_COUNTS);
+            servo_pulse(2 + ch, us);
+            soft_set[ch] = 2 * us;
+        }
+
+        run_until((now / PWM_COUNTS + 1) * PWM_COUNTS);
+    }
+
+    run_until(now + 2 * PWM_COUNTS);
+
+    printf("servo: %lu soft pulses, %lu on time, %lu a count over\n",
+           pulses, late[0], late[1]);
+}
+
+int main(void)
+{
+    servo_init();
+
+    check(ICR1 == PWM_TOP, "ICR1");
+    check((OCR1A == PWM_TOP) && (OCR1B == PWM_TOP), "outputs not off");
+
+    test_scale();
+    test_off();
+
+    /* cruise, no cruise, short, reverse */
+    test_move(2000, 10000, 0, 1000, 2000);
+    test_move(2000, 10000, 0, 2000, 1000);
+    test_move(20000, 10000, 0, 500, 2500);
+    test_move(500, 100000, 0, 1500, 1501);
+    test_move(100, 100, 0, 1500, 1600);
+
+    /* S-curve, 16, 4 and 1 ramp frames */
+    test_move(2000, 10000, 125000, 1000, 2000);
+    test_move(2000, 10000, 500000, 2000, 1000);
+    test_move(2000, 10000, 10000000, 1000, 2000);
+
+    test_random();
+    test_soft();
+
+    printf("servo: %lu checks, %lu errors\n", checks, errors);
+
+    return errors ? 1 : 0;
+}
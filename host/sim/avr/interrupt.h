@@ -0,0 +1,16 @@
+/*
+ * Host simulation, interrupt handlers are plain functions the test calls.
+ * The simulation is single threaded and only delivers interrupts between
+ * calls or while sleeping, so cli and sei have nothing to do.
+ */
+#ifndef _SIM_AVR_INTERRUPT_H_
+#define _SIM_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void)
+
+#define cli() do { } while (0)
+#define sei() do { } while (0)
+
+#endif /* _SIM_AVR_INTERRUPT_H_ */
@@ -0,0 +1,131 @@
+/*
+ * Host simulation of the ATmega328P registers used by the console, the PID,
+ * the TWI and the servo, see host/console_test.c, host/pid_test.c,
+ * host/twi_test.c and host/servo_test.c.  Registers are plain variables
+ * defined by the test.
+ */
+#ifndef _SIM_AVR_IO_H_
+#define _SIM_AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t GPIOR0;
+extern volatile uint8_t SMCR;
+extern volatile uint8_t PINB, PINC, PIND;
+extern volatile uint8_t PORTB, PORTC, PORTD;
+extern volatile uint8_t DDRB, DDRC, DDRD;
+extern volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2;
+extern volatile uint8_t DIDR0;
+extern volatile uint8_t UCSR0A, UCSR0B, UCSR0C;
+extern volatile uint16_t UBRR0;
+extern volatile uint8_t TCNT0, OCR0A, TIFR0, TIMSK0;
+extern volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIFR1, TIMSK1;
+extern volatile uint16_t ICR1, OCR1A, OCR1B;
+extern volatile uint8_t TCNT2, OCR2A, TIFR2, TIMSK2;
+extern volatile uint8_t ADMUX, ADCSRA;
+extern volatile uint16_t ADC;
+extern volatile uint8_t TWBR, TWSR, TWDR, TWCR;
+
+/*
+ * With SIM_TCNT1 each TCNT1 read goes through the test, which advances time,
+ * see servo_test.c.
+ */
+#ifdef SIM_TCNT1
+extern volatile uint16_t * sim_tcnt1(void);
+#define TCNT1 (*sim_tcnt1())
+#else
+extern volatile uint16_t TCNT1;
+#endif
+
+/*
+ * UDR0 is wider than the hardware register so the test can tell whether a
+ * handler wrote it, see console_test.c.
+ */
+extern volatile uint16_t UDR0;
+
+#define GPIOR00 0
+#define GPIOR01 1
+#define GPIOR02 2
+#define GPIOR03 3
+#define GPIOR04 4
+#define GPIOR05 5
+#define GPIOR06 6
+#define GPIOR07 7
+
+#define SE      0
+
+#define RXC0    7
+#define TXC0    6
+#define UDRE0   5
+#define FE0     4
+#define DOR0    3
+#define UPE0    2
+#define U2X0    1
+
+#define RXCIE0  7
+#define TXCIE0  6
+#define UDRIE0  5
+#define RXEN0   4
+#define TXEN0   3
+
+#define UCSZ00  1
+#define UCSZ01  2
+#define USBS0   3
+
+#define OCF0A   1
+#define OCIE0A  1
+
+#define TOV1    0
+#define TOIE1   0
+#define WGM13   4
+
+#define OCF2A   1
+#define OCIE2A  1
+
+#define REFS0   6
+
+#define ADEN    7
+#define ADSC    6
+#define ADPS2   2
+#define ADPS1   1
+#define ADPS0   0
+
+#define TWINT   7
+#define TWEA    6
+#define TWSTA   5
+#define TWSTO   4
+#define TWWC    3
+#define TWEN    2
+#define TWIE    0
+
+#define PCIE0   0
+#define PCIE1   1
+#define PCIE2   2
+
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB2 2
+#define PORTB3 3
+#define PORTB4 4
+#define PORTB5 5
+#define PORTB6 6
+#define PORTB7 7
+#define PORTC0 0
+#define PORTC1 1
+#define PORTC2 2
+#define PORTC3 3
+#define PORTC4 4
+#define PORTC5 5
+#define PORTC6 6
+#define PORTD0 0
+#define PORTD1 1
+#define PORTD2 2
+#define PORTD3 3
+#define PORTD4 4
+#define PORTD5 5
+#define PORTD6 6
+#define PORTD7 7
+
+#endif /* _SIM_AVR_IO_H_ */
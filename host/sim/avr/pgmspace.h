@@ -0,0 +1,22 @@
+/*
+ * Host simulation, program memory is ordinary memory.
+ */
+#ifndef _SIM_AVR_PGMSPACE_H_
+#define _SIM_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P char const *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(address) (*(uint8_t const *) (address))
+#define pgm_read_word(address) (*(uint16_t const *) (address))
+#define pgm_read_dword(address) (*(uint32_t const *) (address))
+#define pgm_read_ptr(address) (*(void * const *) (address))
+
+#define memcpy_P memcpy
+#define strncmp_P strncmp
+
+#endif /* _SIM_AVR_PGMSPACE_H_ */
@@ -0,0 +1,14 @@
+/*
+ * Host simulation, sleeping runs the simulation until the next interrupt.
+ */
+#ifndef _SIM_AVR_SLEEP_H_
+#define _SIM_AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE 0
+
+extern void sim_sleep(void);
+
+#define set_sleep_mode(mode) do { } while (0)
+#define sleep_cpu() sim_sleep()
+
+#endif /* _SIM_AVR_SLEEP_H_ */
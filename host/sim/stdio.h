@@ -0,0 +1,33 @@
+/*
+ * Host simulation, the avr-libc stdio interface the console implements.  The
+ * standard streams are renamed so the console does not replace the host's.
+ */
+#ifndef _SIM_STDIO_H_
+#define _SIM_STDIO_H_
+
+#include <stddef.h>
+
+struct __file {
+    int (* put)(char, struct __file *);
+    int (* get)(struct __file *);
+    unsigned char flags;
+};
+
+typedef struct __file FILE;
+
+#define _FDEV_SETUP_RW 3
+#define _FDEV_ERR (-1)
+#define _FDEV_EOF (-2)
+#define EOF (-1)
+
+#define FDEV_SETUP_STREAM(p, g, f) { .put = p, .get = g, .flags = f }
+
+#define stdin sim_stdin
+#define stdout sim_stdout
+#define stderr sim_stderr
+
+extern FILE * stdin;
+extern FILE * stdout;
+extern FILE * stderr;
+
+#endif /* _SIM_STDIO_H_ */
@@ -0,0 +1,11 @@
+/*
+ * Host simulation, single threaded so every block is atomic.
+ */
+#ifndef _SIM_UTIL_ATOMIC_H_
+#define _SIM_UTIL_ATOMIC_H_
+
+#define ATOMIC_BLOCK(type) for (int _atomic = 1; _atomic; _atomic = 0)
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+#endif /* _SIM_UTIL_ATOMIC_H_ */
@@ -0,0 +1,10 @@
+/*
+ * Host simulation, the rate does not matter.
+ */
+#ifndef _SIM_UTIL_SETBAUD_H_
+#define _SIM_UTIL_SETBAUD_H_
+
+#define UBRR_VALUE 103
+#define USE_2X 0
+
+#endif /* _SIM_UTIL_SETBAUD_H_ */
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host loopback test for telemetry.c.
+ *
+ *  Frames from telemetry_send are written to stdout interleaved with lines of
+ *  text, as the console sends them, for host/tmdecode to decode.  The output
+ *  tmdecode should produce is written to the file named on the command line:
+ *
+ *      ./telemetry_test expect | ./tmdecode > out && cmp out expect
+ *
+ *  Records of every length are sent with random, all zero and all 0xFF
+ *  contents, then a run of 14 byte servo records as main.c sends is timed.
+ *  The records per second through the pipe to tmdecode, and the line rate
+ *  limit at each baud rate for that record, go to stderr.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "console.h"
+#include "telemetry.h"
+
+#define SERVO_RECORDS 100000
+
+static uint8_t const * queued;
+static uint8_t queued_len;
+static unsigned long wire_bytes;
+
+static FILE * expect;
+static unsigned long errors;
+
+/* noted in the expected output too, so the comparison fails */
+static void error(char const * what)
+{
+    fprintf(stderr, "telemetry_send: %s\n", what);
+    fprintf(expect, "error: %s\n", what);
+    errors++;
+}
+
+/*
+ * console stand-ins, a queued frame is sent immediately
+ */
+int8_t console_frame(uint8_t const * frame, uint8_t len)
+{
+    if (queued) return -1;
+
+    queued = frame;
+    queued_len = len;
+
+    return 0;
+}
+
+uint8_t console_frame_busy(void)
+{
+    return queued != NULL;
+}
+
+static void transmit(void)
+{
+    if (queued) {
+        fwrite(queued, 1, queued_len, stdout);
+        wire_bytes += queued_len;
+        queued = NULL;
+    }
+}
+
+static uint32_t random32(void)
+{
+    static uint32_t x = 2463534242UL;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return x;
+}
+
+static void send(uint8_t type, uint8_t const * record, uint8_t len)
+{
+    if (telemetry_send(type, record, len) < 0) {
+        error("record refused");
+        return;
+    }
+
+    /* a second frame is refused until the first is sent */
+    if (telemetry_send(type, record, len) >= 0) {
+        error("queued over a busy frame");
+    }
+
+    transmit();
+
+    fprintf(expect, "[frame type %02x:", type);
+    for (uint8_t i = 0; i < len; i++) fprintf(expect, " %02x", record[i]);
+    fprintf(expect, "]\n");
+}
+
+static void text(unsigned n)
+{
+    printf("text line %u\r\n", n);
+    fprintf(expect, "text line %u\n", n);
+}
+
+int main(int argc, char ** argv)
+{
+    uint8_t record[TELEMETRY_MAX_RECORD + 1];
+    struct timespec t0, t1;
+    unsigned long bytes;
+    double seconds;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s expect-file\n", argv[0]);
+        return 2;
+    }
+
+    expect = fopen(argv[1], "w");
+
+    if (!expect) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    /* too long is refused */
+    if (telemetry_send(0, record, TELEMETRY_MAX_RECORD + 1) >= 0) {
+        error("overlong record queued");
+        transmit();
+    }
+
+    for (unsigned len = 0; len <= TELEMETRY_MAX_RECORD; len++) {
+        for (unsigned i = 0; i < len; i++) record[i] = random32();
+        send(random32(), record, len);
+        text(len);
+
+        memset(record, 0x00, len);
+        send(0x00, record, len);
+
+        memset(record, 0xFF, len);
+        send(0xFF, record, len);
+        text(len);
+    }
+
+    for (unsigned i = 0; i < 10000; i++) {
+        uint8_t const len = random32() % (TELEMETRY_MAX_RECORD + 1);
+
+        for (unsigned j = 0; j < len; j++) {
+            /* mostly zeros, to exercise COBS */
+            record[j] = (random32() & 3) ? 0 : random32();
+        }
+
+        send(random32(), record, len);
+        if (!(i % 7)) text(i);
+    }
+
+    /* timed run of servo records */
+    fflush(stdout);
+    bytes = wire_bytes;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (uint32_t i = 0; i < SERVO_RECORDS; i++) {
+        uint8_t const servo[14] = {
+            i, i >> 8, i >> 16, i >> 24, 0xDC, 0x05, 0xE0, 0x05,
+            i & 0x3F, 0x02, 0xDC, 0x05, 0x00, 0x00,
+        };
+
+        send(1, servo, sizeof(servo));
+    }
+
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    fclose(expect);
+
+    seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    bytes = wire_bytes - bytes;
+
+    fprintf(stderr, "telemetry: %u servo records, %lu bytes each, "
+            "%.0f records/s through tmdecode\n", SERVO_RECORDS,
+            bytes / SERVO_RECORDS, SERVO_RECORDS / seconds);
+
+    /* 11 bit times a byte at 8N2 */
+    {
+        static unsigned long const baud[] = { 9600, 57600, 115200, 1000000 };
+
+        for (unsigned i = 0; i < sizeof(baud) / sizeof(*baud); i++) {
+            fprintf(stderr, "telemetry: %7lu baud line limit %lu records/s\n",
+                    baud[i], baud[i] * SERVO_RECORDS / (11UL * bytes));
+        }
+    }
+
+    return errors ? 1 : 0;
+}
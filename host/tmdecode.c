@@ -0,0 +1,113 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host side decoder for the console telemetry stream, see telemetry.h.
+ *
+ *  Reads the raw serial stream on stdin.  Text is copied to stdout less CR
+ *  and the XON/XOFF flow characters, which the console only sends between
+ *  frames.  Each frame is printed on its own line as its type and record in
+ *  hex, or as a CRC error.
+ *
+ *      cc -o tmdecode host/tmdecode.c
+ *      stty -F /dev/ttyUSB0 9600 raw cstopb && ./tmdecode < /dev/ttyUSB0
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#define MAX_FRAME 512
+
+#define XON  0x11
+#define XOFF 0x13
+
+static uint16_t crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+    crc ^= (uint16_t) data << 8;
+
+    for (int i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+
+    return crc;
+}
+
+static void frame_decode(uint8_t const * in, size_t n)
+{
+    uint8_t out[MAX_FRAME];
+    size_t len = 0;
+    size_t i = 0;
+    uint16_t crc = 0;
+
+    /* undo COBS */
+    while (i < n) {
+        uint8_t code = in[i++];
+
+        if (code == 0) break;
+
+        for (uint8_t j = 1; (j < code) && (i < n); j++) out[len++] = in[i++];
+
+        if ((code != 0xFF) && (i < n)) out[len++] = 0x00;
+    }
+
+    if (len < 3) {
+        printf("[frame: short]\n");
+        return;
+    }
+
+    for (size_t j = 0; j < len; j++) crc = crc_xmodem_update(crc, out[j]);
+
+    if (crc != 0) {
+        printf("[frame: crc error]\n");
+        return;
+    }
+
+    printf("[frame type %02x:", out[0]);
+    for (size_t j = 1; j < len - 2; j++) printf(" %02x", out[j]);
+    printf("]\n");
+}
+
+int main(void)
+{
+    uint8_t frame[MAX_FRAME];
+    size_t n = 0;
+    int in_frame = 0;
+    int c;
+
+    while ((c = getchar()) != EOF) {
+        if (c == 0x00) {
+            /* a delimiter opens a frame, a second closes it */
+            if (in_frame && n) {
+                frame_decode(frame, n);
+                in_frame = 0;
+            }
+            else {
+                in_frame = 1;
+            }
+            n = 0;
+        }
+        else if (in_frame) {
+            if (n < sizeof(frame)) frame[n++] = c;
+        }
+        else if ((c != '\r') && (c != XON) && (c != XOFF)) {
+            putchar(c);
+        }
+
+        fflush(stdout);
+    }
+
+    return 0;
+}
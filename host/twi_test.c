@@ -0,0 +1,471 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test of the TWI master state machine in twi.c.
+ *
+ *  twi.c is built against the register simulation in host/sim.  A simulated
+ *  bus acts on each TWCR write with TWINT set and raises the TWI interrupt
+ *  with the status the hardware would give.  The slave at SLAVE is a small
+ *  memory, the first byte written sets its pointer, then bytes are written
+ *  or read at the pointer.  No other address acknowledges.  Every bus event
+ *  is logged, S START, R repeated START, P STOP, an address or data byte in
+ *  hex then a for ACK or n for NACK, L for a lost arbitration and E for a
+ *  bus error.
+ *
+ *   - Directed transactions check the bus log, status and statistics for a
+ *     write, a write then read, a read alone, an absent slave, a chain, a
+ *     failure inside a chain, lost arbitration with and without recovery,
+ *     and a bus error.  A transaction already queued is refused.
+ *   - A random run queues transactions with random chains and faults, and
+ *     checks every status, each completion exactly once and in order, and
+ *     the data read against a model of the slave memory.
+ *
+ *  The bus flags a STOP or data on a bus the master does not hold, and an
+ *  access to the data register outside a byte transfer.
+ *
+ *      make -C host test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <util/twi.h>
+
+#include "twi.h"
+
+#define SLAVE     (0x20)
+#define ABSENT    (0x21)
+#define MEM_SIZE  (16)
+#define XFERS     (100000UL)
+#define QUEUE     (8)
+
+/*
+ * Simulated registers.
+ */
+volatile uint8_t PORTB, PORTC, PORTD;
+volatile uint8_t SMCR;
+volatile uint8_t TWBR, TWSR, TWDR, TWCR;
+
+extern void TWI_vect(void);
+
+/* bus state */
+enum { IDLE, ADDRESS, WRITE, READ, LOST };
+
+static int bus;
+static int bus_error;           /* a bus error released the bus */
+static uint8_t mem[MEM_SIZE];
+static uint8_t pointer;
+static uint8_t first;           /* the next byte written sets the pointer */
+
+/* faults, lose the next arb_lose addresses, NACK the next pointer byte */
+static unsigned arb_lose;
+static unsigned nack_pointer;
+static unsigned bus_errors;
+
+static char bus_log[256];
+
+static unsigned long checks;
+static unsigned long errors;
+
+static void check(int ok, char const * what)
+{
+    checks++;
+    if (!ok && (errors++ < 10)) fprintf(stderr, "twi: %s\n", what);
+}
+
+static void log_event(char const * fmt, unsigned value)
+{
+    size_t const len = strlen(bus_log);
+
+    if (len < sizeof(bus_log) - 8) {
+        snprintf(bus_log + len, sizeof(bus_log) - len, fmt, value);
+    }
+}
+
+static void interrupt(uint8_t status)
+{
+    TWSR = status;
+    if (TWCR & _BV(TWIE)) TWI_vect();
+}
+
+/*
+ * START, a repeated START when the master holds the bus.
+ */
+static void start(void)
+{
+    if ((bus == IDLE) || (bus == LOST)) {
+        log_event(" S", 0);
+        bus = ADDRESS;
+        interrupt(TW_START);
+    } else {
+        log_event(" R", 0);
+        bus = ADDRESS;
+        interrupt(TW_REP_START);
+    }
+}
+
+static void address(uint8_t sla)
+{
+    uint8_t const read = sla & TW_READ;
+
+    if (bus_errors) {
+        bus_errors--;
+        log_event(" %02xE", sla);
+        bus = IDLE;
+        bus_error = 1;
+        interrupt(TW_BUS_ERROR);
+    } else if (arb_lose) {
+        arb_lose--;
+        log_event(" %02xL", sla);
+        bus = LOST;
+        interrupt(TW_MT_ARB_LOST);
+    } else if ((sla >> 1) != SLAVE) {
+        log_event(" %02xn", sla);
+        bus = read ? READ : WRITE;
+        interrupt(read ? TW_MR_SLA_NACK : TW_MT_SLA_NACK);
+    } else {
+        log_event(" %02xa", sla);
+        first = !read;
+        bus = read ? READ : WRITE;
+        interrupt(read ? TW_MR_SLA_ACK : TW_MT_SLA_ACK);
+    }
+}
+
+static void write(uint8_t data)
+{
+    if (first && nack_pointer) {
+        nack_pointer--;
+        log_event(" %02xn", data);
+        interrupt(TW_MT_DATA_NACK);
+    } else {
+        if (first) pointer = data;
+        else mem[pointer++ % MEM_SIZE] = data;
+        first = 0;
+
+        log_event(" %02xa", data);
+        interrupt(TW_MT_DATA_ACK);
+    }
+}
+
+static void read(uint8_t ack)
+{
+    TWDR = mem[pointer++ % MEM_SIZE];
+
+    log_event(ack ? " %02xa" : " %02xn", TWDR);
+    interrupt(ack ? TW_MR_DATA_ACK : TW_MR_DATA_NACK);
+}
+
+/*
+ * Run the bus until nothing more is asked of it, each TWCR write with TWINT
+ * set is taken as the next command.
+ */
+static void run(void)
+{
+    while (TWCR & _BV(TWINT)) {
+        uint8_t const twcr = TWCR;
+
+        TWCR &= ~_BV(TWINT);
+
+        if (!(twcr & _BV(TWEN))) {
+            check(0, "command with the TWI off");
+            return;
+        }
+
+        if (twcr & _BV(TWSTO)) {
+            if ((bus == IDLE) && bus_error) {
+                /* recovery, no STOP on the bus */
+                bus_error = 0;
+            } else if ((bus == IDLE) || (bus == LOST)) {
+                check(0, "STOP without the bus");
+            } else {
+                log_event(" P", 0);
+                bus = IDLE;
+            }
+
+            TWCR &= ~_BV(TWSTO);
+        }
+
+        if (twcr & _BV(TWSTA)) {
+            start();
+        } else if (twcr & _BV(TWSTO)) {
+            /* STOP alone, no interrupt */
+        } else if (bus == ADDRESS) {
+            address(TWDR);
+        } else if (bus == WRITE) {
+            write(TWDR);
+        } else if (bus == READ) {
+            read(twcr & _BV(TWEA));
+        } else if (bus == LOST) {
+            /* not addressed slave, the winner has the bus */
+            bus = IDLE;
+        } else {
+            check(0, "data without the bus");
+        }
+    }
+}
+
+void sim_sleep(void)
+{
+    run();
+}
+
+/*
+ * Completion order, each transaction is to complete once, in queue order.
+ */
+static struct twi_xfer * done_order[QUEUE];
+static unsigned done_count;
+
+static void done(struct twi_xfer * this_xfer)
+{
+    if (done_count < QUEUE) done_order[done_count] = this_xfer;
+    done_count++;
+}
+
+static void xfer_set(struct twi_xfer * this_xfer, uint8_t address,
+                     uint8_t flags, uint8_t const * wbuf, uint8_t wlen,
+                     uint8_t * rbuf, uint8_t rlen)
+{
+    memset(this_xfer, 0, sizeof(*this_xfer));
+    this_xfer->address = address;
+    this_xfer->flags = flags;
+    this_xfer->wbuf = wbuf;
+    this_xfer->wlen = wlen;
+    this_xfer->rbuf = rbuf;
+    this_xfer->rlen = rlen;
+    this_xfer->done = done;
+}
+
+static void expect_log(char const * expect, char const * what)
+{
+    if (strcmp(bus_log, expect)) {
+        fprintf(stderr, "twi: %s\n  got   \"%s\"\n  want  \"%s\"\n", what,
+                bus_log, expect);
+        check(0, what);
+    } else {
+        check(1, what);
+    }
+
+    bus_log[0] = '\0';
+}
+
+static void test_directed(void)
+{
+    static uint8_t const w1[] = { 0x04, 0x11, 0x22, 0x33 };
+    static uint8_t const w2[] = { 0x05 };
+    static uint8_t const w3[] = { 0x00, 0xaa };
+    struct twi_xfer x[4];
+    struct twi_stats stats;
+    uint8_t r[4];
+
+    /* write */
+    xfer_set(&x[0], SLAVE, 0, w1, sizeof(w1), NULL, 0);
+    check(twi_submit(&x[0]) == 0, "submit");
+    check(twi_busy(), "not busy after submit");
+    check(twi_submit(&x[0]) == -1, "queued twice");
+    check(twi_wait(&x[0]) == TWI_OK, "write status");
+    check(!twi_busy(), "busy after the last transaction");
+    expect_log(" S 40a 04a 11a 22a 33a P", "write");
+
+    /* write then read, ACK all but the last byte */
+    xfer_set(&x[0], SLAVE, 0, w2, sizeof(w2), r, 2);
+    twi_submit(&x[0]);
+    check(twi_wait(&x[0]) == TWI_OK, "write read status");
+    check((r[0] == 0x22) && (r[1] == 0x33), "write read data");
+    expect_log(" S 40a 05a R 41a 22a 33n P", "write read");
+
+    /* read alone, from the pointer */
+    xfer_set(&x[0], SLAVE, 0, NULL, 0, r, 1);
+    twi_submit(&x[0]);
+    check(twi_wait(&x[0]) == TWI_OK, "read status");
+    check(r[0] == mem[7], "read data");
+    expect_log(" S 41a 00n P", "read");
+
+    /* absent slave */
+    twi_clear_stats();
+    xfer_set(&x[0], ABSENT, 0, w2, sizeof(w2), NULL, 0);
+    twi_submit(&x[0]);
+    check(twi_wait(&x[0]) == TWI_NACK, "absent status");
+    twi_get_stats(&stats);
+    check((stats.nacks == 1) && (stats.xfers == 1), "absent stats");
+    expect_log(" S 42n P", "absent");
+
+    /* chain, one repeated START between, STOP then START for the next */
+    done_count = 0;
+    xfer_set(&x[0], SLAVE, TWI_CHAIN, w3, sizeof(w3), NULL, 0);
+    xfer_set(&x[1], SLAVE, 0, w2, sizeof(w2), NULL, 0);
+    xfer_set(&x[2], SLAVE, 0, w3, 1, r, 1);
+    twi_submit(&x[0]);
+    twi_submit(&x[1]);
+    twi_submit(&x[2]);
+    check(twi_wait(&x[2]) == TWI_OK, "chain status");
+    check((x[0].status == TWI_OK) && (x[1].status == TWI_OK), "chain");
+    check((done_count == 3) && (done_order[0] == &x[0])
+          && (done_order[1] == &x[1]) && (done_order[2] == &x[2]),
+          "chain completion order");
+    check(r[0] == 0xaa, "chain data");
+    expect_log(" S 40a 00a aaa R 40a 05a P S 40a 00a R 41a aan P", "chain");
+
+    /* a failure in a chain aborts the rest of it, not the next */
+    xfer_set(&x[0], ABSENT, TWI_CHAIN, w2, sizeof(w2), NULL, 0);
+    xfer_set(&x[1], SLAVE, TWI_CHAIN, w3, sizeof(w3), NULL, 0);
+    xfer_set(&x[2], SLAVE, 0, w3, sizeof(w3), NULL, 0);
+    xfer_set(&x[3], SLAVE, 0, w2, sizeof(w2), NULL, 0);
+    twi_submit(&x[0]);
+    twi_submit(&x[1]);
+    twi_submit(&x[2]);
+    twi_submit(&x[3]);
+    check(twi_wait(&x[3]) == TWI_OK, "after chain status");
+    check((x[0].status == TWI_NACK) && (x[1].status == TWI_ABORTED)
+          && (x[2].status == TWI_ABORTED), "chain abort");
+    expect_log(" S 42n P S 40a 05a P", "chain abort");
+
+    /* lost arbitration, retried, no STOP from the loser */
+    twi_clear_stats();
+    arb_lose = TWI_RETRIES;
+    xfer_set(&x[0], SLAVE, 0, w2, sizeof(w2), NULL, 0);
+    twi_submit(&x[0]);
+    check(twi_wait(&x[0]) == TWI_OK, "arbitration retry status");
+    twi_get_stats(&stats);
+    check(stats.arb_lost == TWI_RETRIES, "arbitration stats");
+    expect_log(" S 40L S 40L S 40L S 40a 05a P", "arbitration retry");
+
+    arb_lose = TWI_RETRIES + 1;
+    xfer_set(&x[0], SLAVE, 0, w2, sizeof(w2), NULL, 0);
+    xfer_set(&x[1], SLAVE, 0, w2, sizeof(w2), NULL, 0);
+    twi_submit(&x[0]);
+    twi_submit(&x[1]);
+    check(twi_wait(&x[0]) == TWI_ARB_LOST, "arbitration lost status");
+    check(twi_wait(&x[1]) == TWI_OK, "after arbitration lost");
+    expect_log(" S 40L S 40L S 40L S 40L S 40a 05a P", "arbitration lost");
+
+    /* bus error, recovered without a STOP */
+    bus_errors = 1;
+    xfer_set(&x[0], SLAVE, 0, w2, sizeof(w2), NULL, 0);
+    twi_submit(&x[0]);
+    check(twi_wait(&x[0]) == TWI_BUS_ERROR, "bus error status");
+    twi_get_stats(&stats);
+    check(stats.bus_errors == 1, "bus error stats");
+    check(!bus_error, "bus error not recovered");
+    expect_log(" S 40E", "bus error");
+    check(!(TWCR & _BV(TWSTO)), "STOP still pending");
+
+    xfer_set(&x[0], SLAVE, 0, w2, sizeof(w2), NULL, 0);
+    twi_submit(&x[0]);
+    check(twi_wait(&x[0]) == TWI_OK, "after bus error");
+    expect_log(" S 40a 05a P", "after bus error");
+}
+
+/*
+ * Random transactions through the slave memory, a queue of up to QUEUE at a
+ * time with random chains, lost arbitration and NACKs.
+ */
+static void test_random(void)
+{
+    static struct twi_xfer x[QUEUE];
+    static uint8_t wbuf[QUEUE][1 + MEM_SIZE];
+    static uint8_t rbuf[QUEUE][MEM_SIZE];
+    uint8_t model[MEM_SIZE];
+    unsigned long n = 0;
+    unsigned long ok = 0;
+    unsigned long aborted = 0;
+
+    memcpy(model, mem, sizeof(model));
+
+    while (n < XFERS) {
+        unsigned const queued = 1 + rand() % QUEUE;
+        int failed = 0;
+        unsigned i;
+        unsigned j;
+
+        done_count = 0;
+        arb_lose = (rand() % 8) ? 0 : rand() % (TWI_RETRIES + 2);
+        nack_pointer = (rand() % 8) ? 0 : 1;
+
+        for (i = 0; i < queued; i++) {
+            uint8_t const wlen = 1 + rand() % 4;
+            uint8_t const rlen = rand() % 4;
+            uint8_t const flags = (rand() % 2) ? TWI_CHAIN : 0;
+
+            wbuf[i][0] = rand() % MEM_SIZE;
+            for (j = 1; j < wlen; j++) wbuf[i][j] = rand();
+
+            xfer_set(&x[i], (rand() % 16) ? SLAVE : ABSENT, flags, wbuf[i],
+                     wlen, rbuf[i], rlen);
+            check(twi_submit(&x[i]) == 0, "random submit");
+        }
+
+        run();
+
+        check(done_count == queued, "random completions");
+        check(!twi_busy(), "random busy");
+
+        /*
+         * Follow the queue against the model, a failure aborts the rest of
+         * its chain, and a failed transaction changed nothing.
+         */
+        for (i = 0; i < queued; i++) {
+            struct twi_xfer const * const t = &x[i];
+            uint8_t p = t->wbuf[0];
+
+            check((i >= QUEUE) || (done_order[i] == t), "random order");
+
+            if (failed) {
+                check(t->status == TWI_ABORTED, "random not aborted");
+                aborted++;
+            } else if (t->status == TWI_OK) {
+                check(t->address == SLAVE, "random absent slave ok");
+
+                for (j = 1; j < t->wlen; j++) model[p++ % MEM_SIZE] = t->wbuf[j];
+                for (j = 0; j < t->rlen; j++) {
+                    check(t->rbuf[j] == model[p++ % MEM_SIZE], "random data");
+                }
+
+                ok++;
+            } else {
+                check((t->status == TWI_NACK) || (t->status == TWI_ARB_LOST),
+                      "random status");
+                failed = 1;
+            }
+
+            if (!(t->flags & TWI_CHAIN)) failed = 0;
+        }
+
+        check(!memcmp(model, mem, sizeof(model)), "random memory");
+        bus_log[0] = '\0';
+
+        n += queued;
+    }
+
+    printf("twi: %lu transactions, %lu ok, %lu aborted\n", n, ok, aborted);
+}
+
+int main(void)
+{
+    twi_init();
+
+    check(TWCR == _BV(TWEN), "TWCR after init");
+    check(TWBR == ((16000000UL / 100000UL) - 16) / 2, "TWBR");
+
+    test_directed();
+    test_random();
+
+    printf("twi: %lu checks, %lu errors\n", checks, errors);
+
+    return errors ? 1 : 0;
+}
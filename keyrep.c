@@ -0,0 +1,108 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "project.h"
+
+#include <stdint.h>
+
+#include "timer.h"
+#include "keyrep.h"
+
+
+static uint32_t mask;
+
+static struct keyrep_params params = {
+    .delay = TBTICKS_FROM_MS(500),
+    .interval = TBTICKS_FROM_MS(100),
+    .min = TBTICKS_FROM_MS(10),
+    .accel = 5,
+};
+
+/* the held keys, the next repeat, the current interval */
+static uint32_t repeat_keys;
+static tbtick_t repeat_at;
+static tbtick_t repeat_step;
+static uint8_t repeat_count;
+
+
+void keyrep_init(uint32_t repeat_mask)
+{
+    mask = repeat_mask;
+    repeat_keys = 0;
+}
+
+
+void keyrep_get_params(struct keyrep_params * this_params)
+{
+    *this_params = params;
+}
+
+
+/*
+ * Takes effect from the next press.
+ */
+void keyrep_set_params(struct keyrep_params const * this_params)
+{
+    params = *this_params;
+}
+
+
+uint8_t keyrep_scan(uint32_t keys, uint32_t keys_down, uint32_t now)
+{
+    uint8_t n = 0;
+
+    if (keys_down & mask)
+    {
+        repeat_keys = keys & mask;
+        repeat_at = now + params.delay;
+        repeat_step = params.interval;
+        repeat_count = 0;
+
+        return 0;
+    }
+
+    if ((0 == params.delay) || (0 == repeat_keys) || (keys != repeat_keys))
+    {
+        repeat_keys = 0;
+
+        return 0;
+    }
+
+    while ((tbtick_st) (now - repeat_at) >= 0)
+    {
+        if (++n == UINT8_MAX)
+        {
+            /* too far behind, drop the rest */
+            repeat_at = now;
+        }
+
+        repeat_at += repeat_step;
+
+        if (params.accel && (++repeat_count >= params.accel))
+        {
+            repeat_count = 0;
+            repeat_step = max(repeat_step / 2, params.min);
+        }
+    }
+
+    return n;
+}
+
+
+uint32_t keyrep_keys(void)
+{
+    return repeat_keys;
+}
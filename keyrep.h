@@ -0,0 +1,52 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _KEYREP_H_
+#define _KEYREP_H_
+
+#include <stdint.h>
+
+/*
+ * Auto-repeat timing, in timebase ticks.  The first repeat comes delay after
+ * the press, then every interval, halving after every accel repeats down to
+ * min.  A delay of 0 turns repeat off, an accel of 0 keeps the rate.  The
+ * interval and min must not be 0.
+ */
+struct keyrep_params {
+    uint32_t delay;
+    uint32_t interval;
+    uint32_t min;
+    uint8_t accel;
+};
+
+/*
+ * Held key auto-repeat
+ *
+ *  keyrep_init sets the keys that repeat and the default timing.  The caller
+ *  passes each key scan to keyrep_scan with the keys held, the keys newly
+ *  pressed and the time of the scan.  A new press of a repeating key restarts
+ *  the timing, any other change in the keys held stops it.  keyrep_scan
+ *  returns the number of repeats due by the scan, all of them, so a slow
+ *  caller sees one larger count rather than missing repeats, capped at 255.
+ *  keyrep_keys returns the repeating keys held.
+ */
+extern void keyrep_init(uint32_t mask);
+extern void keyrep_get_params(struct keyrep_params * this_params);
+extern void keyrep_set_params(struct keyrep_params const * this_params);
+extern uint8_t keyrep_scan(uint32_t keys, uint32_t keys_down, uint32_t now);
+extern uint32_t keyrep_keys(void);
+
+#endif /* _KEYREP_H_ */
@@ -17,7 +17,13 @@
 #ifndef _BITS_H_
 #define _BITS_H_
 
+#ifdef __AVR__
 #include <avr/io.h>
+#else
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
+#endif
 #include <stdint.h>
 
 #define _BVl(a) (1UL<<(a))
@@ -17,7 +17,10 @@
 #ifndef _LIBRB_H_
 #define _LIBRB_H_
 
+#ifdef __AVR__
 #include <avr/io.h>
+#endif
+#include <stddef.h>
 #include "bits.h"
 
 /*
@@ -105,5 +108,92 @@ extern int8_t rb_echo(struct ring_buffer * const rb, volatile uint8_t * const b)
 extern int8_t rb_get(struct ring_buffer * const rb, volatile uint8_t * const b);
 extern uint8_t rb_erase(struct ring_buffer * const rb);
 extern uint8_t rb_kill(struct ring_buffer * const rb, uint8_t * p);
+extern size_t rb_count(struct ring_buffer * const rb);
+
+/*
+ * ring-buffer bulk and in place access, at most two contiguous segments
+ */
+extern int8_t rb_write(struct ring_buffer * const rb, void const * buf, size_t * const len);
+extern int8_t rb_read(struct ring_buffer * const rb, void * buf, size_t * const len);
+extern int8_t rb_peek_contig(struct ring_buffer * const rb, uint8_t ** const p, size_t * const len);
+extern int8_t rb_commit(struct ring_buffer * const rb, size_t len);
+extern int8_t rb_reserve(struct ring_buffer * const rb, uint8_t ** const p, size_t * const len);
+extern int8_t rb_publish(struct ring_buffer * const rb, size_t len);
+
+/*
+ * power-of-two ring-buffer control structure
+ *
+ *  A variant of struct ring_buffer for buffers of 2, 4, ... 128 bytes with the
+ *  same put/echo/get semantics.  The cursors are free running 8-bit indices
+ *  masked on access, so wrap is an and rather than a 16-bit compare and
+ *  reload, and full, empty, can't echo and can't get follow from the indices
+ *  instead of flag bits.  The state is 7 bytes against 11.
+ *
+ *  flags carries no ring-buffer state, all of its bits are spare, the RB_SPARE
+ *  masks can be used as with struct ring_buffer.
+ */
+struct ring_buffer8 {
+    uint8_t * buf;
+    uint8_t mask;
+    volatile uint8_t put;
+    volatile uint8_t echo;
+    volatile uint8_t get;
+
+    uint8_t flags;
+};
+
+/*
+ * power-of-two ring-buffer state
+ */
+#define rb8_is_cantput(a)   ((uint8_t) ((a)->put - (a)->get) > (a)->mask)
+#define rb8_is_cantecho(a)  ((a)->echo == (a)->put)
+#define rb8_is_cantget(a)   ((a)->get == (a)->echo)
+#define rb8_empty(a)        ((a)->get == (a)->put)
+#define rb8_full(a)         rb8_is_cantput(a)
+
+/*
+ * clear power-of-two ring-buffer
+ */
+#define rb8_clear(a) do {                                                      \
+    (a)->get = (a)->echo = (a)->put = 0;                                       \
+} while (0)
+
+/*
+ * power-of-two ring-buffer control/access functions
+ */
+extern void rb8_init(struct ring_buffer8 * const rb, uint8_t * const p, uint8_t s);
+extern int8_t rb8_put(struct ring_buffer8 * const rb, volatile uint8_t const * const b);
+extern int8_t rb8_put_echo(struct ring_buffer8 * const rb, volatile uint8_t const * const b);
+extern int8_t rb8_unput(struct ring_buffer8 * const rb, volatile uint8_t * const b);
+extern int8_t rb8_echo(struct ring_buffer8 * const rb, volatile uint8_t * const b);
+extern int8_t rb8_get(struct ring_buffer8 * const rb, volatile uint8_t * const b);
+extern uint8_t rb8_erase(struct ring_buffer8 * const rb);
+extern uint8_t rb8_kill(struct ring_buffer8 * const rb, uint8_t p);
+extern uint8_t rb8_count(struct ring_buffer8 * const rb);
+
+/*
+ * single-producer/single-consumer ring-buffer control structure
+ *
+ *  A power-of-two ring-buffer shared between exactly one producer and one
+ *  consumer, such as an interrupt handler and the main loop, with no critical
+ *  section.  Each side writes only its own index and there are no shared flag
+ *  bits to read-modify-write.  The indices are single bytes so loads and
+ *  stores are atomic on the AVR, the __atomic builtins order the buffer
+ *  access against the index update.  No echo cursor.
+ */
+struct ring_spsc {
+    uint8_t * buf;
+    uint8_t mask;
+    uint8_t put;
+    uint8_t get;
+};
+
+/*
+ * single-producer/single-consumer ring-buffer control/access functions
+ */
+extern void rbs_init(struct ring_spsc * const rb, uint8_t * const p, uint8_t s);
+extern int8_t rbs_put(struct ring_spsc * const rb, volatile uint8_t const * const b);
+extern int8_t rbs_get(struct ring_spsc * const rb, volatile uint8_t * const b);
+extern uint8_t rbs_count(struct ring_spsc * const rb);
 
 #endif /* _LIBRB_H_ */
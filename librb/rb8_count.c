@@ -0,0 +1,33 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rb8_count - power-of-two ring-buffer count
+ *
+ *  Return the number of bytes held in the ring-buffer, from get to put, which
+ *  includes bytes not yet echoed.
+ *
+ * returns:  number of bytes held
+ */
+uint8_t rb8_count(struct ring_buffer8 * const rb)
+{
+    return rb->put - rb->get;
+}
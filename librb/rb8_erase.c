@@ -0,0 +1,45 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rb8_erase - power-of-two ring-buffer erase
+ *
+ *  Rewind the buffer back one byte.
+ *
+ * returns:  1 - echo index was moved
+ *           0 - echo index was not moved
+ */
+uint8_t rb8_erase(struct ring_buffer8 * const rb)
+{
+    uint8_t put = rb->put;
+
+    if (put == rb->get) return 0;
+
+    rb->put = put - 1;
+
+    /* if can't echo on entry we backed over an echoed byte */
+    if (rb->echo == put) {
+        rb->echo = put - 1;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rb8_get - power-of-two ring-buffer get
+ *
+ *  If available, return byte from the head of the ring-buffer and update the
+ *  control structure.
+ *
+ * returns:  1 - byte returned, more available
+ *           0 - byte returned, no more available
+ *          -1 - byte not returned, none available
+ */
+int8_t rb8_get(struct ring_buffer8 * const rb, volatile uint8_t * const b)
+{
+    uint8_t get = rb->get;
+
+    if (get == rb->echo) return -1;
+
+    /* return byte, space will be available for put */
+    *b = rb->buf[get & rb->mask];
+    get++;
+    rb->get = get;
+
+    /* more available on exit */
+    return get != rb->echo;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * initialize a power-of-two ring-buffer control structure, s must be a power
+ * of two no larger than 128
+ */
+void rb8_init(struct ring_buffer8 * const rb, uint8_t * const p, uint8_t s)
+{
+    rb->buf = p;
+    rb->mask = s - 1;
+    rb->flags = 0;
+    rb8_clear(rb);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rb8_kill - power-of-two ring-buffer kill
+ *
+ *  Rewind the buffer back to the passed index.  Return the number of echoed
+ *  bytes removed.  The caller is responsible for passing a p value in the
+ *  range get to put inclusive.
+ */
+uint8_t rb8_kill(struct ring_buffer8 * const rb, uint8_t p)
+{
+    uint8_t const get = rb->get;
+    uint8_t unecho = 0;
+
+    /* distances from get never wrap */
+    if ((uint8_t) (p - get) < (uint8_t) (rb->put - get)) {
+        rb->put = p;
+        if ((uint8_t) (p - get) < (uint8_t) (rb->echo - get)) {
+            unecho = rb->echo - p;
+            rb->echo = p;
+        }
+    }
+
+    return unecho;
+}
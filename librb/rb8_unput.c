@@ -0,0 +1,48 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rb8_unput - power-of-two ring-buffer un-put
+ *
+ *  If available, return byte from the tail of the ring-buffer and update the
+ *  control structure.
+ *
+ * returns:  1 - byte returned, more available
+ *           0 - byte returned, no more available
+ *          -1 - byte not returned, none available
+ */
+int8_t rb8_unput(struct ring_buffer8 * const rb, volatile uint8_t * const b)
+{
+    uint8_t put = rb->put;
+
+    if (put == rb->get) return -1;
+
+    /* if can't echo on entry, can't echo on exit */
+    if (rb->echo == put) rb->echo = put - 1;
+
+    /* return byte, update index */
+    put--;
+    *b = rb->buf[put & rb->mask];
+    rb->put = put;
+
+    /* more available on exit */
+    return put != rb->get;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rb_commit - ring-buffer commit
+ *
+ *  Release len bytes from the head of the ring-buffer, after they were read in
+ *  place through rb_peek_contig.  The caller is responsible for len being no
+ *  more than is available.
+ *
+ * returns:  1 - more available
+ *           0 - no more available
+ */
+int8_t rb_commit(struct ring_buffer * const rb, size_t len)
+{
+    uint8_t * get;
+
+    if (len) {
+        get = rb->get + len;
+        if (get >= rb->limit) get -= rb->limit - rb->start;
+        rb->get = get;
+
+        /* space will be available for put */
+        rb_clr_cantput(rb);
+
+        if (get == rb->echo) rb_set_cantget(rb);
+    }
+
+    return !rb_is_cantget(rb);
+}
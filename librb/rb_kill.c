@@ -24,7 +24,8 @@
  *
  *  Rewind the buffer back to the passed pointer position.  Return the number of
  *  echoed bytes removed.  The caller is responsible for passing a p value in
- *  the range get to put inclusive.
+ *  the range get to put inclusive.  When the ring-buffer is full put equals
+ *  get and p is taken as get, everything is removed.
  */
 uint8_t rb_kill(struct ring_buffer * const rb, uint8_t * p)
 {
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rb_peek_contig - ring-buffer contiguous peek
+ *
+ *  Point *p at the head of the ring-buffer and set *len to the number of bytes
+ *  available there without wrapping.  The bytes stay in the ring-buffer until
+ *  released with rb_commit.
+ *
+ * returns:  1 - span returned, more available after the wrap
+ *           0 - span returned, no more available
+ *          -1 - no span returned, none available
+ */
+int8_t rb_peek_contig(struct ring_buffer * const rb, uint8_t ** const p,
+                      size_t * const len)
+{
+    uint8_t * const get = rb->get;
+    uint8_t * end;
+
+    if (rb_is_cantget(rb)) {
+        *len = 0;
+        return -1;
+    }
+
+    end = (get < rb->echo) ? rb->echo : rb->limit;
+
+    *p = get;
+    *len = end - get;
+
+    return (end == rb->limit) && (rb->echo != rb->start);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rb_publish - ring-buffer publish
+ *
+ *  Add len bytes written in place through rb_reserve to the tail of the
+ *  ring-buffer.  The caller is responsible for len being no more than was
+ *  reserved.  This API also disables the echo facility, as rb_put.
+ *
+ * returns:  1 - more space available
+ *           0 - no more space available
+ */
+int8_t rb_publish(struct ring_buffer * const rb, size_t len)
+{
+    uint8_t * put;
+
+    if (len) {
+        put = rb->put + len;
+        if (put >= rb->limit) put -= rb->limit - rb->start;
+
+        /* bytes will not be available for echo, will be available for get */
+        rb_set_cantecho(rb);
+        rb_clr_cantget(rb);
+        rb->echo = rb->put = put;
+
+        if (put == rb->get) rb_set_cantput(rb);
+    }
+
+    return !rb_is_cantput(rb);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "librb.h"
+
+
+/*
+ * rb_read - ring-buffer read
+ *
+ *  Return up to *len bytes from the head of the ring-buffer in at most two
+ *  contiguous copies and update the control structure once.  *len is set to
+ *  the number of bytes returned.
+ *
+ * returns:  1 - bytes returned, more available
+ *           0 - bytes returned, no more available
+ *          -1 - no bytes returned, none available
+ */
+int8_t rb_read(struct ring_buffer * const rb, void * buf, size_t * const len)
+{
+    uint8_t * dst = buf;
+    uint8_t * get;
+    size_t left = *len;
+
+    if (rb_is_cantget(rb)) {
+        *len = 0;
+        return -1;
+    }
+
+    if (!left) return 1;
+
+    get = rb->get;
+
+    do {
+        /* contiguous data ends at echo or at the end of the buffer */
+        size_t n = ((get < rb->echo) ? rb->echo : rb->limit) - get;
+
+        if (n > left) n = left;
+
+        memcpy(dst, get, n);
+        dst += n;
+        left -= n;
+
+        get += n;
+        if (get == rb->limit) get = rb->start;
+        if (get == rb->echo) rb_set_cantget(rb);
+    } while (left && !rb_is_cantget(rb));
+
+    *len -= left;
+
+    /* space will be available for put */
+    rb_clr_cantput(rb);
+    rb->get = get;
+
+    return !rb_is_cantget(rb);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rb_reserve - ring-buffer contiguous reserve
+ *
+ *  Point *p at the tail of the ring-buffer and set *len to the space available
+ *  there without wrapping.  Bytes written in place are added with rb_publish.
+ *
+ * returns:  1 - span returned, more space after the wrap
+ *           0 - span returned, no more space
+ *          -1 - no span returned, no space available
+ */
+int8_t rb_reserve(struct ring_buffer * const rb, uint8_t ** const p,
+                  size_t * const len)
+{
+    uint8_t * const put = rb->put;
+    uint8_t * end;
+
+    if (rb_is_cantput(rb)) {
+        *len = 0;
+        return -1;
+    }
+
+    end = (put < rb->get) ? rb->get : rb->limit;
+
+    *p = put;
+    *len = end - put;
+
+    return (end == rb->limit) && (rb->get != rb->start);
+}
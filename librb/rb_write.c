@@ -0,0 +1,74 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "librb.h"
+
+
+/*
+ * rb_write - ring-buffer write
+ *
+ *  Add up to *len bytes to the tail of the ring-buffer in at most two
+ *  contiguous copies and update the control structure once.  *len is set to
+ *  the number of bytes added.  This API also disables the echo facility, as
+ *  rb_put.
+ *
+ * returns:  1 - bytes added, more space available
+ *           0 - bytes added, no more space available
+ *          -1 - no bytes added, no space available
+ */
+int8_t rb_write(struct ring_buffer * const rb, void const * buf,
+                size_t * const len)
+{
+    uint8_t const * src = buf;
+    uint8_t * put;
+    size_t left = *len;
+
+    if (rb_is_cantput(rb)) {
+        *len = 0;
+        return -1;
+    }
+
+    if (!left) return 1;
+
+    put = rb->put;
+
+    do {
+        /* contiguous space ends at get or at the end of the buffer */
+        size_t n = ((put < rb->get) ? rb->get : rb->limit) - put;
+
+        if (n > left) n = left;
+
+        memcpy(put, src, n);
+        src += n;
+        left -= n;
+
+        put += n;
+        if (put == rb->limit) put = rb->start;
+        if (put == rb->get) rb_set_cantput(rb);
+    } while (left && !rb_is_cantput(rb));
+
+    *len -= left;
+
+    /* bytes will not be available for echo, will be available for get */
+    rb_set_cantecho(rb);
+    rb_clr_cantget(rb);
+    rb->echo = rb->put = put;
+
+    return !rb_is_cantput(rb);
+}
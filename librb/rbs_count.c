@@ -0,0 +1,34 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rbs_count - single-producer/single-consumer ring-buffer count
+ *
+ *  Return the number of bytes held in the ring-buffer.  From the producer the
+ *  count can only fall after the call, from the consumer it can only rise.
+ *
+ * returns:  number of bytes held
+ */
+uint8_t rbs_count(struct ring_spsc * const rb)
+{
+    return __atomic_load_n(&rb->put, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&rb->get, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rbs_get - single-consumer ring-buffer get
+ *
+ *  If available, return byte from the head of the ring-buffer.  Only the
+ *  consumer may call this, it writes only the get index.  The byte is read
+ *  before its slot is released to the producer.
+ *
+ * returns:  1 - byte returned, more available
+ *           0 - byte returned, no more available
+ *          -1 - byte not returned, none available
+ */
+int8_t rbs_get(struct ring_spsc * const rb, volatile uint8_t * const b)
+{
+    uint8_t const get = rb->get;
+    uint8_t const put = __atomic_load_n(&rb->put, __ATOMIC_ACQUIRE);
+
+    if (get == put) return -1;
+
+    *b = rb->buf[get & rb->mask];
+    __atomic_store_n(&rb->get, (uint8_t) (get + 1), __ATOMIC_RELEASE);
+
+    /* more available on exit */
+    return (uint8_t) (get + 1) != put;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "librb.h"
+
+
+/*
+ * rbs_put - single-producer ring-buffer put
+ *
+ *  If space available, add byte to the tail of the ring-buffer.  Only the
+ *  producer may call this, it writes only the put index.  The byte is stored
+ *  before the index is released to the consumer.
+ *
+ * returns:  1 - byte added, more space available
+ *           0 - byte added, no more space available
+ *          -1 - byte not added, no space available
+ */
+int8_t rbs_put(struct ring_spsc * const rb, volatile uint8_t const * const b)
+{
+    uint8_t const put = rb->put;
+    uint8_t const get = __atomic_load_n(&rb->get, __ATOMIC_ACQUIRE);
+
+    if ((uint8_t) (put - get) > rb->mask) return -1;
+
+    rb->buf[put & rb->mask] = *b;
+    __atomic_store_n(&rb->put, (uint8_t) (put + 1), __ATOMIC_RELEASE);
+
+    /* space on exit */
+    return (uint8_t) (put + 1 - get) <= rb->mask;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _RBT_H_
+#define _RBT_H_
+
+#include <stdint.h>
+
+/*
+ * typed ring-buffer generator
+ *
+ *  RBT_DEFINE(name, type, size) defines struct name, a ring-buffer of size
+ *  elements of type, and its static inline access functions:
+ *
+ *   name_init(rb)          - empty the ring-buffer
+ *   name_count(rb)         - number of elements held
+ *   name_push(rb, e)       - add *e at the tail
+ *   name_push_over(rb, e)  - add *e at the tail, discarding the oldest
+ *                            element if full
+ *   name_pop(rb, e)        - remove the head into *e
+ *   name_peek(rb)          - pointer to the head element, or NULL
+ *
+ *  size is a power of two no larger than 128.  The element type and size are
+ *  compile time constants so indexing is a mask and a constant multiply, or a
+ *  shift for power of two element sizes.  The put and get indices are free
+ *  running single bytes.
+ *
+ *  push and pop return -1/0/1 as rb_put and rb_get.  name_push_over returns 0
+ *  if an element was discarded, 1 otherwise.
+ *
+ *  push and pop are safe between one producer and one consumer with no
+ *  critical section, as struct ring_spsc.  push_over moves the get index from
+ *  the producer side and so needs the consumer excluded, pop with interrupts
+ *  disabled when the producer is an interrupt handler.
+ *
+ *      RBT_DEFINE(key_events, struct key_event, 8);
+ *      static struct key_events key_q;
+ */
+#define RBT_DEFINE(name, type, size)                                           \
+                                                                               \
+typedef char name##_size_check[(((size) & ((size) - 1)) == 0) &&               \
+                               ((size) <= 128) ? 1 : -1];                      \
+                                                                               \
+struct name {                                                                  \
+    type buf[size];                                                            \
+    uint8_t put;                                                               \
+    uint8_t get;                                                               \
+};                                                                             \
+                                                                               \
+static __inline void name##_init(struct name * const rb)                       \
+{                                                                              \
+    rb->put = 0;                                                               \
+    rb->get = 0;                                                               \
+}                                                                              \
+                                                                               \
+static __inline uint8_t name##_count(struct name * const rb)                   \
+{                                                                              \
+    return __atomic_load_n(&rb->put, __ATOMIC_ACQUIRE) -                       \
+           __atomic_load_n(&rb->get, __ATOMIC_ACQUIRE);                        \
+}                                                                              \
+                                                                               \
+static __inline int8_t name##_push(struct name * const rb,                     \
+                                   type const * const e)                       \
+{                                                                              \
+    uint8_t const put = rb->put;                                               \
+    uint8_t const get = __atomic_load_n(&rb->get, __ATOMIC_ACQUIRE);           \
+                                                                               \
+    if ((uint8_t) (put - get) >= (size)) return -1;                            \
+                                                                               \
+    rb->buf[put & ((size) - 1)] = *e;                                          \
+    __atomic_store_n(&rb->put, (uint8_t) (put + 1), __ATOMIC_RELEASE);         \
+                                                                               \
+    return (uint8_t) (put + 1 - get) < (size);                                 \
+}                                                                              \
+                                                                               \
+static __inline int8_t name##_push_over(struct name * const rb,                \
+                                        type const * const e)                  \
+{                                                                              \
+    uint8_t const put = rb->put;                                               \
+    int8_t ret = 1;                                                            \
+                                                                               \
+    if ((uint8_t) (put - rb->get) >= (size)) {                                 \
+        rb->get++;                                                             \
+        ret = 0;                                                               \
+    }                                                                          \
+                                                                               \
+    rb->buf[put & ((size) - 1)] = *e;                                          \
+    __atomic_store_n(&rb->put, (uint8_t) (put + 1), __ATOMIC_RELEASE);         \
+                                                                               \
+    return ret;                                                                \
+}                                                                              \
+                                                                               \
+static __inline int8_t name##_pop(struct name * const rb, type * const e)      \
+{                                                                              \
+    uint8_t const get = rb->get;                                               \
+    uint8_t const put = __atomic_load_n(&rb->put, __ATOMIC_ACQUIRE);           \
+                                                                               \
+    if (get == put) return -1;                                                 \
+                                                                               \
+    *e = rb->buf[get & ((size) - 1)];                                          \
+    __atomic_store_n(&rb->get, (uint8_t) (get + 1), __ATOMIC_RELEASE);         \
+                                                                               \
+    return (uint8_t) (get + 1) != put;                                         \
+}                                                                              \
+                                                                               \
+static __inline type * name##_peek(struct name * const rb)                     \
+{                                                                              \
+    uint8_t const get = rb->get;                                               \
+                                                                               \
+    if (get == __atomic_load_n(&rb->put, __ATOMIC_ACQUIRE)) return 0;          \
+                                                                               \
+    return &rb->buf[get & ((size) - 1)];                                       \
+}
+
+#endif /* _RBT_H_ */
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host throughput benchmark of the ring-buffers.
+ *
+ *  Bytes are moved through a 32 byte ring in bursts of 24, the way the
+ *  console fills and drains its rings, and the cost per byte is reported
+ *  for each access pattern.  Host timings rank the implementations and
+ *  catch regressions, they are not AVR cycle counts.
+ *
+ *      make -C librb bench
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "librb.h"
+#include "rbt.h"
+
+#define BYTES (20000000UL)
+#define SIZE  (32)
+#define BURST (24)
+
+static uint8_t buffer[SIZE];
+static volatile uint8_t sink;
+
+RBT_DEFINE(bytes, uint8_t, SIZE)
+
+static double seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(char const * name, double start)
+{
+    printf("bench: %-26s %5.2f ns/byte\n", name,
+           (seconds() - start) * 1e9 / BYTES);
+}
+
+static void bench_put_get(void)
+{
+    struct ring_buffer rb;
+    unsigned long i;
+    uint8_t b = 0;
+    uint8_t n;
+    double start;
+
+    rb_init(&rb, buffer, SIZE);
+    start = seconds();
+
+    for (i = 0; i < BYTES; i += BURST) {
+        for (n = 0; n < BURST; n++) rb_put(&rb, &b);
+        for (n = 0; n < BURST; n++) rb_get(&rb, &b);
+    }
+
+    sink = b;
+    report("rb_put/rb_get", start);
+}
+
+static void bench_put_echo_get(void)
+{
+    struct ring_buffer rb;
+    unsigned long i;
+    uint8_t b = 0;
+    uint8_t n;
+    double start;
+
+    rb_init(&rb, buffer, SIZE);
+    start = seconds();
+
+    for (i = 0; i < BYTES; i += BURST) {
+        for (n = 0; n < BURST; n++) rb_put_echo(&rb, &b);
+        for (n = 0; n < BURST; n++) rb_echo(&rb, &b);
+        for (n = 0; n < BURST; n++) rb_get(&rb, &b);
+    }
+
+    sink = b;
+    report("rb_put_echo/rb_echo/rb_get", start);
+}
+
+static void bench_write_read(void)
+{
+    struct ring_buffer rb;
+    uint8_t block[BURST] = { 0 };
+    unsigned long i;
+    size_t len;
+    double start;
+
+    rb_init(&rb, buffer, SIZE);
+    start = seconds();
+
+    for (i = 0; i < BYTES; i += BURST) {
+        len = BURST;
+        rb_write(&rb, block, &len);
+        len = BURST;
+        rb_read(&rb, block, &len);
+    }
+
+    sink = block[0];
+    report("rb_write/rb_read", start);
+}
+
+static void bench_rb8(void)
+{
+    struct ring_buffer8 rb;
+    unsigned long i;
+    uint8_t b = 0;
+    uint8_t n;
+    double start;
+
+    rb8_init(&rb, buffer, SIZE);
+    start = seconds();
+
+    for (i = 0; i < BYTES; i += BURST) {
+        for (n = 0; n < BURST; n++) rb8_put(&rb, &b);
+        for (n = 0; n < BURST; n++) rb8_get(&rb, &b);
+    }
+
+    sink = b;
+    report("rb8_put/rb8_get", start);
+}
+
+static void bench_rbs(void)
+{
+    struct ring_spsc rb;
+    unsigned long i;
+    uint8_t b = 0;
+    uint8_t n;
+    double start;
+
+    rbs_init(&rb, buffer, SIZE);
+    start = seconds();
+
+    for (i = 0; i < BYTES; i += BURST) {
+        for (n = 0; n < BURST; n++) rbs_put(&rb, &b);
+        for (n = 0; n < BURST; n++) rbs_get(&rb, &b);
+    }
+
+    sink = b;
+    report("rbs_put/rbs_get", start);
+}
+
+static void bench_rbt(void)
+{
+    static struct bytes rb;
+    unsigned long i;
+    uint8_t b = 0;
+    uint8_t n;
+    double start;
+
+    bytes_init(&rb);
+    start = seconds();
+
+    for (i = 0; i < BYTES; i += BURST) {
+        for (n = 0; n < BURST; n++) bytes_push(&rb, &b);
+        for (n = 0; n < BURST; n++) bytes_pop(&rb, &b);
+    }
+
+    sink = b;
+    report("RBT_DEFINE push/pop", start);
+}
+
+int main(void)
+{
+    bench_put_get();
+    bench_put_echo_get();
+    bench_write_read();
+    bench_rb8();
+    bench_rbs();
+    bench_rbt();
+
+    return 0;
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Model based fuzz test of the three cursor ring-buffers, struct ring_buffer
+ * and struct ring_buffer8.
+ *
+ *  The model holds the bytes from get to put in order with a count of how
+ *  many of them, from get, are past the echo cursor.  Random sequences of
+ *  rb_put, rb_put_echo, rb_echo, rb_get, rb_unput, rb_erase, rb_kill and
+ *  rb_count are applied to both.  Every return value and byte is checked,
+ *  and after every call the put, echo and get pointers and the CANTPUT,
+ *  CANTECHO and CANTGET flags are checked against the model.  Each phase
+ *  biases the operation mix toward filling or draining so the full, empty
+ *  and wrapped states are all visited, for ring sizes from 1 to 255.  At the
+ *  power-of-two sizes up to 128 the rb8_* calls run in lock step against the
+ *  same model, and their indices and state macros are checked the same way.
+ *
+ *      make -C librb test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "librb.h"
+
+#define STEPS  (200000UL)
+#define PHASE  (64)
+
+/* model */
+static uint8_t model[256];
+static uint8_t model_size;
+static uint8_t model_get;    /* offset of get from start */
+static uint8_t model_count;  /* bytes held, get to put */
+static uint8_t model_echoed; /* bytes from get that may be got */
+
+static uint8_t buffer[256];
+static struct ring_buffer rb;
+
+static uint8_t buffer8[128];
+static struct ring_buffer8 rb8;
+static uint8_t use8;
+
+static unsigned long checks;
+static unsigned long errors;
+static unsigned long step;
+
+static char const * op_name;
+
+static void fail(char const * what)
+{
+    if (errors++ < 10) {
+        fprintf(stderr, "rb: size %u step %lu %s: %s\n", model_size, step,
+                op_name, what);
+    }
+}
+
+static void check(int ok, char const * what)
+{
+    checks++;
+    if (!ok) fail(what);
+}
+
+static uint8_t * model_ptr(uint8_t offset)
+{
+    return buffer + (model_get + offset) % model_size;
+}
+
+static uint8_t model_at(uint8_t offset)
+{
+    return model[(model_get + offset) % model_size];
+}
+
+/*
+ * The ring-buffer state matches the model.
+ */
+static void check_state(void)
+{
+    check(rb.get == model_ptr(0), "get pointer");
+    check(rb.echo == model_ptr(model_echoed), "echo pointer");
+    check(rb.put == model_ptr(model_count), "put pointer");
+    check(!rb_is_cantput(&rb) == (model_count != model_size), "CANTPUT");
+    check(!rb_is_cantget(&rb) == (model_echoed != 0), "CANTGET");
+    check(!rb_is_cantecho(&rb) == (model_echoed != model_count), "CANTECHO");
+    check(rb_count(&rb) == model_count, "count");
+
+    if (!use8) return;
+
+    check((rb8.get & rb8.mask) == model_get, "rb8 get index");
+    check((uint8_t) (rb8.echo - rb8.get) == model_echoed, "rb8 echo index");
+    check((uint8_t) (rb8.put - rb8.get) == model_count, "rb8 put index");
+    check(!rb8_is_cantput(&rb8) == (model_count != model_size), "rb8 CANTPUT");
+    check(!rb8_is_cantget(&rb8) == (model_echoed != 0), "rb8 CANTGET");
+    check(!rb8_is_cantecho(&rb8) == (model_echoed != model_count),
+          "rb8 CANTECHO");
+    check(rb8_count(&rb8) == model_count, "rb8 count");
+}
+
+static void do_put(uint8_t echo)
+{
+    uint8_t b = rand();
+    int8_t expect;
+    int8_t r;
+    int8_t r8 = 0;
+
+    op_name = echo ? "rb_put_echo" : "rb_put";
+    r = echo ? rb_put_echo(&rb, &b) : rb_put(&rb, &b);
+    if (use8) r8 = echo ? rb8_put_echo(&rb8, &b) : rb8_put(&rb8, &b);
+
+    if (model_count == model_size) {
+        expect = -1;
+    }
+    else {
+        model[(model_get + model_count++) % model_size] = b;
+        if (!echo) model_echoed = model_count;
+        expect = model_count != model_size;
+    }
+
+    check(r == expect, "return value");
+    if (use8) check(r8 == expect, "rb8 return value");
+}
+
+static void do_echo(void)
+{
+    uint8_t b = 0;
+    uint8_t b8 = 0;
+    int8_t expect;
+    int8_t r;
+    int8_t r8 = 0;
+
+    op_name = "rb_echo";
+    r = rb_echo(&rb, &b);
+    if (use8) r8 = rb8_echo(&rb8, &b8);
+
+    if (model_echoed == model_count) {
+        expect = -1;
+    }
+    else {
+        check(b == model_at(model_echoed), "byte");
+        if (use8) check(b8 == model_at(model_echoed), "rb8 byte");
+        model_echoed++;
+        expect = model_echoed != model_count;
+    }
+
+    check(r == expect, "return value");
+    if (use8) check(r8 == expect, "rb8 return value");
+}
+
+static void do_get(void)
+{
+    uint8_t b = 0;
+    uint8_t b8 = 0;
+    int8_t expect;
+    int8_t r;
+    int8_t r8 = 0;
+
+    op_name = "rb_get";
+    r = rb_get(&rb, &b);
+    if (use8) r8 = rb8_get(&rb8, &b8);
+
+    if (!model_echoed) {
+        expect = -1;
+    }
+    else {
+        check(b == model_at(0), "byte");
+        if (use8) check(b8 == model_at(0), "rb8 byte");
+        model_get = (model_get + 1) % model_size;
+        model_count--;
+        model_echoed--;
+        expect = model_echoed != 0;
+    }
+
+    check(r == expect, "return value");
+    if (use8) check(r8 == expect, "rb8 return value");
+}
+
+static void do_unput(void)
+{
+    uint8_t b = 0;
+    uint8_t b8 = 0;
+    int8_t expect;
+    int8_t r;
+    int8_t r8 = 0;
+
+    op_name = "rb_unput";
+    r = rb_unput(&rb, &b);
+    if (use8) r8 = rb8_unput(&rb8, &b8);
+
+    if (!model_count) {
+        expect = -1;
+    }
+    else {
+        model_count--;
+        check(b == model_at(model_count), "byte");
+        if (use8) check(b8 == model_at(model_count), "rb8 byte");
+        if (model_echoed > model_count) model_echoed = model_count;
+        expect = model_count != 0;
+    }
+
+    check(r == expect, "return value");
+    if (use8) check(r8 == expect, "rb8 return value");
+}
+
+static void do_erase(void)
+{
+    uint8_t expect = 0;
+
+    op_name = "rb_erase";
+
+    if (model_count) {
+        /* an echoed byte is erased if none are waiting for echo */
+        expect = model_echoed == model_count;
+        model_count--;
+        if (expect) model_echoed = model_count;
+    }
+
+    check(rb_erase(&rb) == expect, "return value");
+    if (use8) check(rb8_erase(&rb8) == expect, "rb8 return value");
+}
+
+static void do_kill(void)
+{
+    /* when full put is get, p may not be put */
+    uint8_t const k = rand() % (model_count + (model_count != model_size));
+    uint8_t const p8 = rb8.get + k;
+    uint8_t expect = 0;
+
+    op_name = "rb_kill";
+
+    if (k < model_echoed) {
+        expect = model_echoed - k;
+        model_echoed = k;
+    }
+    model_count = k;
+
+    check(rb_kill(&rb, model_ptr(k)) == expect, "return value");
+    if (use8) check(rb8_kill(&rb8, p8) == expect, "rb8 return value");
+}
+
+static void fuzz(uint8_t size)
+{
+    uint8_t fill = 0;
+    uint8_t op;
+
+    model_size = size;
+    model_get = 0;
+    model_count = 0;
+    model_echoed = 0;
+    rb_init(&rb, buffer, size);
+
+    /* power-of-two sizes the rb8 variant takes */
+    use8 = (size <= sizeof(buffer8)) && !(size & (size - 1));
+    if (use8) rb8_init(&rb8, buffer8, size);
+
+    op_name = "rb_init";
+    check_state();
+
+    for (step = 0; step < STEPS; step++) {
+        /* each phase fills or drains */
+        if (!(step % PHASE)) fill = rand() & 1;
+
+        op = rand() % 16;
+
+        if (op < 5) {
+            if (fill || (op < 2)) do_put(op & 1);
+            else do_get();
+        }
+        else if (op < 9) {
+            do_echo();
+        }
+        else if (op < 12) {
+            if (!fill || (op < 10)) do_get();
+            else do_put(op & 1);
+        }
+        else if (op < 13) {
+            do_unput();
+        }
+        else if (op < 14) {
+            do_erase();
+        }
+        else if (op < 15) {
+            if (!(rand() % 4)) do_kill();
+            else do_echo();
+        }
+        else {
+            op_name = "rb_count";
+        }
+
+        check_state();
+    }
+}
+
+int main(void)
+{
+    static uint8_t const sizes[] = { 1, 2, 3, 4, 7, 8, 16, 31, 32, 128, 255 };
+    uint8_t i;
+
+    srand(1);
+
+    for (i = 0; i < sizeof(sizes); i++) fuzz(sizes[i]);
+
+    printf("rb: %lu checks, %lu errors\n", checks, errors);
+
+    return errors ? 1 : 0;
+}
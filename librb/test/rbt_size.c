@@ -0,0 +1,130 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Code size of RBT_DEFINE against hand-written rings.
+ *
+ *  Each push and pop is compiled twice, once from RBT_DEFINE and once written
+ *  out by hand for the element type, as out of line functions so their sizes
+ *  can be read from the symbol table.  Build for the target or the host and
+ *  compare the rbt_ and hand_ sizes:
+ *
+ *      make -C librb/test size
+ *      make -C librb/test size CC=avr-gcc NM=avr-nm \
+ *          SIZE_CFLAGS="-Os -mmcu=atmega328p"
+ */
+#include <stdint.h>
+
+#include "rbt.h"
+
+struct event {
+    uint32_t tbtick;
+    uint16_t key;
+    uint8_t state;
+    uint8_t count;
+};
+
+RBT_DEFINE(words, uint16_t, 16)
+RBT_DEFINE(events, struct event, 8)
+
+int8_t rbt_words_push(struct words * const rb, uint16_t const * const e)
+{
+    return words_push(rb, e);
+}
+
+int8_t rbt_words_pop(struct words * const rb, uint16_t * const e)
+{
+    return words_pop(rb, e);
+}
+
+int8_t rbt_events_push(struct events * const rb, struct event const * const e)
+{
+    return events_push(rb, e);
+}
+
+int8_t rbt_events_pop(struct events * const rb, struct event * const e)
+{
+    return events_pop(rb, e);
+}
+
+/*
+ * Hand-written, the usual interrupt-safe ring with volatile indices.
+ */
+struct hand_words {
+    uint16_t buf[16];
+    volatile uint8_t put;
+    volatile uint8_t get;
+};
+
+int8_t hand_words_push(struct hand_words * const rb, uint16_t const * const e)
+{
+    uint8_t const put = rb->put;
+    uint8_t const get = rb->get;
+
+    if ((uint8_t) (put - get) >= 16) return -1;
+
+    rb->buf[put & 15] = *e;
+    rb->put = put + 1;
+
+    return (uint8_t) (put + 1 - get) < 16;
+}
+
+int8_t hand_words_pop(struct hand_words * const rb, uint16_t * const e)
+{
+    uint8_t const get = rb->get;
+    uint8_t const put = rb->put;
+
+    if (get == put) return -1;
+
+    *e = rb->buf[get & 15];
+    rb->get = get + 1;
+
+    return (uint8_t) (get + 1) != put;
+}
+
+struct hand_events {
+    struct event buf[8];
+    volatile uint8_t put;
+    volatile uint8_t get;
+};
+
+int8_t hand_events_push(struct hand_events * const rb,
+                        struct event const * const e)
+{
+    uint8_t const put = rb->put;
+    uint8_t const get = rb->get;
+
+    if ((uint8_t) (put - get) >= 8) return -1;
+
+    rb->buf[put & 7] = *e;
+    rb->put = put + 1;
+
+    return (uint8_t) (put + 1 - get) < 8;
+}
+
+int8_t hand_events_pop(struct hand_events * const rb, struct event * const e)
+{
+    uint8_t const get = rb->get;
+    uint8_t const put = rb->put;
+
+    if (get == put) return -1;
+
+    *e = rb->buf[get & 7];
+    rb->get = get + 1;
+
+    return (uint8_t) (get + 1) != put;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _RING_SUITE_H_
+#define _RING_SUITE_H_
+
+/*
+ * Ring-buffer test suite shared by the byte and typed ring-buffers.
+ *
+ *  RING_SUITE(name, type, size, make, same) defines name_suite(), run against
+ *  any ring with the RBT_DEFINE interface: name_init, name_count, name_push
+ *  and name_pop, returning -1/0/1 as rb_put and rb_get.  make(i, e) sets *e
+ *  to the i'th test element and same(a, b) compares two elements.
+ *
+ *  RING_SUITE_OVER(name, type, size, make, same) adds name_suite_over() for
+ *  rings that also have name_push_over and name_peek.
+ *
+ *  The includer provides unsigned long checks and errors, and fail().
+ */
+#define RING_SUITE(name, type, size, make, same)                               \
+                                                                               \
+static void name##_suite(void)                                                 \
+{                                                                              \
+    static struct name rb;                                                     \
+    type model[size];                                                          \
+    uint8_t model_get = 0;                                                     \
+    uint8_t model_count = 0;                                                   \
+    unsigned long next = 0;                                                    \
+    unsigned long step;                                                        \
+    int8_t expect;                                                             \
+    int8_t r;                                                                  \
+    type e;                                                                    \
+                                                                               \
+    name##_init(&rb);                                                          \
+                                                                               \
+    /* empty */                                                                \
+    checks++;                                                                  \
+    if (name##_count(&rb) || (name##_pop(&rb, &e) != -1)) {                    \
+        fail(#name, 0, "not empty after init");                                \
+    }                                                                          \
+                                                                               \
+    /*                                                                         \
+     * Random pushes and pops against an array model, long enough for the      \
+     * free running indices to wrap many times.  Every return value, count     \
+     * and element is checked.                                                 \
+     */                                                                        \
+    for (step = 0; step < 100000UL; step++) {                                  \
+        checks++;                                                              \
+                                                                               \
+        if (rand() & 1) {                                                      \
+            make(next, &e);                                                    \
+            r = name##_push(&rb, &e);                                          \
+                                                                               \
+            if (model_count == (size)) {                                       \
+                expect = -1;                                                   \
+            }                                                                  \
+            else {                                                             \
+                model[(model_get + model_count++) % (size)] = e;               \
+                next++;                                                        \
+                expect = model_count < (size);                                 \
+            }                                                                  \
+                                                                               \
+            if (r != expect) fail(#name, step, "push returned wrong value");   \
+        }                                                                      \
+        else {                                                                 \
+            r = name##_pop(&rb, &e);                                           \
+                                                                               \
+            if (!model_count) {                                                \
+                expect = -1;                                                   \
+            }                                                                  \
+            else {                                                             \
+                if (!same(&e, &model[model_get])) {                            \
+                    fail(#name, step, "popped wrong element");                 \
+                }                                                              \
+                model_get = (model_get + 1) % (size);                          \
+                expect = --model_count != 0;                                   \
+            }                                                                  \
+                                                                               \
+            if (r != expect) fail(#name, step, "pop returned wrong value");    \
+        }                                                                      \
+                                                                               \
+        if (name##_count(&rb) != model_count) {                                \
+            fail(#name, step, "count differs from model");                     \
+        }                                                                      \
+    }                                                                          \
+}
+
+#define RING_SUITE_OVER(name, type, size, make, same)                          \
+                                                                               \
+static void name##_suite_over(void)                                            \
+{                                                                              \
+    static struct name rb;                                                     \
+    unsigned long i;                                                           \
+    type * p;                                                                  \
+    type e;                                                                    \
+    type f;                                                                    \
+                                                                               \
+    name##_init(&rb);                                                          \
+                                                                               \
+    /* overwrite oldest, the newest size elements are kept */                  \
+    for (i = 0; i < 1000; i++) {                                               \
+        checks++;                                                              \
+        make(i, &e);                                                           \
+                                                                               \
+        if (name##_push_over(&rb, &e) != (i < (size))) {                       \
+            fail(#name, i, "push_over returned wrong value");                  \
+        }                                                                      \
+                                                                               \
+        make((i < (size)) ? 0 : i + 1 - (size), &f);                           \
+        p = name##_peek(&rb);                                                  \
+                                                                               \
+        if (!p || !same(p, &f)) fail(#name, i, "peek wrong after push_over");  \
+    }                                                                          \
+                                                                               \
+    for (i = 1000 - (size); i < 1000; i++) {                                   \
+        checks++;                                                              \
+        make(i, &f);                                                           \
+                                                                               \
+        if ((name##_pop(&rb, &e) < 0) || !same(&e, &f)) {                      \
+            fail(#name, i, "popped wrong element after push_over");            \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    checks++;                                                                  \
+    if (name##_peek(&rb) || name##_count(&rb)) {                               \
+        fail(#name, i, "not empty after push_over drain");                     \
+    }                                                                          \
+}
+
+#endif /* _RING_SUITE_H_ */
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test of the byte and typed ring-buffers through one shared suite.
+ *
+ *  ring_suite.h is run against the byte ring-buffers, struct ring_buffer,
+ *  struct ring_buffer8 and struct ring_spsc, through thin adapters, and
+ *  against RBT_DEFINE rings of uint16_t and of an 8-byte struct.  The typed
+ *  rings are also run through the overwrite-oldest suite.
+ *
+ *      make -C librb test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "librb.h"
+#include "rbt.h"
+
+#define SIZE (16)
+
+static unsigned long checks;
+static unsigned long errors;
+
+static void fail(char const * name, unsigned long step, char const * what)
+{
+    if (errors++ < 10) fprintf(stderr, "ring: %s step %lu: %s\n", name, step,
+                               what);
+}
+
+#include "ring_suite.h"
+
+/*
+ * byte ring-buffer adapters
+ */
+#define BYTE_ADAPTER(name, ring, prefix, init_size)                            \
+                                                                               \
+struct name {                                                                  \
+    struct ring rb;                                                            \
+    uint8_t buf[SIZE];                                                         \
+};                                                                             \
+                                                                               \
+static void name##_init(struct name * const r)                                 \
+{                                                                              \
+    prefix##_init(&r->rb, r->buf, init_size);                                  \
+}                                                                              \
+                                                                               \
+static uint8_t name##_count(struct name * const r)                             \
+{                                                                              \
+    return prefix##_count(&r->rb);                                             \
+}                                                                              \
+                                                                               \
+static int8_t name##_push(struct name * const r, uint8_t const * const e)      \
+{                                                                              \
+    return prefix##_put(&r->rb, e);                                            \
+}                                                                              \
+                                                                               \
+static int8_t name##_pop(struct name * const r, uint8_t * const e)             \
+{                                                                              \
+    return prefix##_get(&r->rb, e);                                            \
+}
+
+BYTE_ADAPTER(bytes, ring_buffer, rb, SIZE)
+BYTE_ADAPTER(bytes8, ring_buffer8, rb8, SIZE)
+BYTE_ADAPTER(bytes_spsc, ring_spsc, rbs, SIZE)
+
+/*
+ * typed ring-buffers
+ */
+struct event {
+    uint32_t tbtick;
+    uint16_t key;
+    uint8_t state;
+    uint8_t count;
+};
+
+typedef char event_size_check[(sizeof(struct event) == 8) ? 1 : -1];
+
+RBT_DEFINE(words, uint16_t, SIZE)
+RBT_DEFINE(events, struct event, SIZE / 2)
+
+/*
+ * test elements
+ */
+static void make_byte(unsigned long i, uint8_t * const e)
+{
+    *e = i * 7;
+}
+
+static int same_byte(uint8_t const * const a, uint8_t const * const b)
+{
+    return *a == *b;
+}
+
+static void make_word(unsigned long i, uint16_t * const e)
+{
+    *e = i * 40503U;
+}
+
+static int same_word(uint16_t const * const a, uint16_t const * const b)
+{
+    return *a == *b;
+}
+
+static void make_event(unsigned long i, struct event * const e)
+{
+    e->tbtick = i * 2654435761UL;
+    e->key = i;
+    e->state = i >> 16;
+    e->count = ~i;
+}
+
+static int same_event(struct event const * const a,
+                      struct event const * const b)
+{
+    return !memcmp(a, b, sizeof(*a));
+}
+
+RING_SUITE(bytes, uint8_t, SIZE, make_byte, same_byte)
+RING_SUITE(bytes8, uint8_t, SIZE, make_byte, same_byte)
+RING_SUITE(bytes_spsc, uint8_t, SIZE, make_byte, same_byte)
+RING_SUITE(words, uint16_t, SIZE, make_word, same_word)
+RING_SUITE(events, struct event, SIZE / 2, make_event, same_event)
+RING_SUITE_OVER(words, uint16_t, SIZE, make_word, same_word)
+RING_SUITE_OVER(events, struct event, SIZE / 2, make_event, same_event)
+
+int main(void)
+{
+    srand(1);
+
+    bytes_suite();
+    bytes8_suite();
+    bytes_spsc_suite();
+    words_suite();
+    events_suite();
+    words_suite_over();
+    events_suite_over();
+
+    printf("ring: %lu checks, %lu errors\n", checks, errors);
+
+    return errors ? 1 : 0;
+}
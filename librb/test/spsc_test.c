@@ -0,0 +1,144 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host concurrency stress test for the single-producer/single-consumer ring.
+ *
+ *  A producer thread stands in for an interrupt handler and the main thread
+ *  for the main loop.  The producer puts a pseudo-random byte stream with
+ *  rbs_put, the consumer takes it with rbs_get and regenerates the stream
+ *  from the same seed, so any lost, repeated or reordered byte is a mismatch.
+ *  Each side yields when the ring is full or empty.  Run for each size from
+ *  the smallest ring to the largest, 2 to 128 bytes.
+ *
+ *      make -C librb test
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "librb.h"
+
+#define BYTES (1000000UL)
+
+static uint8_t buffer[128];
+static struct ring_spsc ring;
+
+static unsigned long put_full;
+static unsigned long errors;
+
+static uint32_t xorshift(uint32_t * const x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+
+    return *x >> 24;
+}
+
+static void * producer(void * arg)
+{
+    uint32_t x = 1;
+    unsigned long i;
+    uint8_t b;
+
+    (void) arg;
+
+    for (i = 0; i < BYTES; i++) {
+        b = xorshift(&x);
+
+        while (rbs_put(&ring, &b) < 0) {
+            put_full++;
+            sched_yield();
+        }
+
+        if (rbs_count(&ring) > ring.mask + 1U) errors++;
+    }
+
+    return 0;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void stress(uint8_t size)
+{
+    pthread_t thread;
+    unsigned long get_empty = 0;
+    unsigned long i;
+    uint32_t x = 1;
+    double start;
+    uint8_t b;
+
+    rbs_init(&ring, buffer, size);
+    put_full = 0;
+
+    start = seconds();
+
+    if (pthread_create(&thread, 0, producer, 0)) {
+        fprintf(stderr, "spsc: thread create failed\n");
+        errors++;
+        return;
+    }
+
+    for (i = 0; i < BYTES; i++) {
+        while (rbs_get(&ring, &b) < 0) {
+            get_empty++;
+            sched_yield();
+        }
+
+        if (b != xorshift(&x)) {
+            if (errors++ < 10) {
+                fprintf(stderr, "spsc: size %u byte %lu out of order\n",
+                        size, i);
+            }
+        }
+    }
+
+    pthread_join(thread, 0);
+
+    if (rbs_count(&ring)) {
+        fprintf(stderr, "spsc: size %u %u bytes left over\n", size,
+                rbs_count(&ring));
+        errors++;
+    }
+
+    printf("spsc: size %3u, %lu bytes, %4.1f Mbytes/s, %lu full, %lu empty\n",
+           size, BYTES, BYTES / (seconds() - start) / 1e6, put_full,
+           get_empty);
+}
+
+int main(void)
+{
+    uint16_t size;
+
+    for (size = 2; size <= sizeof(buffer); size <<= 1) stress(size);
+
+    printf("spsc: %lu errors\n", errors);
+
+    return errors ? 1 : 0;
+}
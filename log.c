@@ -0,0 +1,218 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "project.h"
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "librb.h"
+#include "console.h"
+#include "log.h"
+
+/*
+ * Priority and bulk lanes.  Each message is queued as a length byte followed
+ * by the message.
+ */
+#ifndef LOG_BUF_SIZE
+#define LOG_BUF_SIZE (96)
+#endif
+#ifndef LOG_PRIO_SIZE
+#define LOG_PRIO_SIZE (32)
+#endif
+static uint8_t bulk_buffer[LOG_BUF_SIZE];
+static uint8_t prio_buffer[LOG_PRIO_SIZE];
+static struct ring_buffer bulk_rb;
+static struct ring_buffer prio_rb;
+
+/*
+ * Levels at or above this severity use the priority lane.
+ */
+#define LOG_PRIO_LEVEL LOG_ERR
+
+/*
+ * Messages less severe than the threshold are discarded without counting.
+ */
+static uint8_t threshold;
+
+static uint8_t policy[LOG_LEVELS];
+
+static struct log_stats stats;
+
+
+/*
+ * Remove the message at the head of a lane.
+ */
+static void lane_drop(struct ring_buffer * const rb)
+{
+    uint8_t len;
+    uint8_t c;
+
+    rb_get(rb, &len);
+
+    while (len--) rb_get(rb, &c);
+}
+
+
+/*
+ * Move queued messages to the console, priority lane first.  Without block
+ * stops at the first message the console has no room for.  Messages go to the
+ * console straight from the lane, in two pieces where the lane wraps.
+ */
+static void log_drain(uint8_t block)
+{
+    struct ring_buffer * rb;
+    uint8_t * p;
+    size_t n;
+
+    for (;;) {
+        if (!rb_is_cantget(&prio_rb)) rb = &prio_rb;
+        else if (!rb_is_cantget(&bulk_rb)) rb = &bulk_rb;
+        else break;
+
+        uint8_t len = *rb->get;
+
+        /*
+         * Only the main loop queues to the console, the room can only grow
+         * while the pieces are written.
+         */
+        if (!block && (len > console_tx_room())) break;
+
+        rb_commit(rb, 1);
+
+        while (len) {
+            rb_peek_contig(rb, &p, &n);
+            if (n > len) n = len;
+
+            if (block) console_write(p, n);
+            else console_trywrite(p, n);
+
+            rb_commit(rb, n);
+            len -= n;
+        }
+    }
+}
+
+
+/*
+ * write, log one message
+ *
+ *  Returns 0 if the message was written or queued, or was below the
+ *  threshold, -1 if it was dropped.
+ */
+int8_t log_write(uint8_t level, void const * msg, uint8_t len)
+{
+    struct ring_buffer * rb;
+    uint8_t const * p = msg;
+
+    if (level >= LOG_LEVELS) level = LOG_LEVELS - 1;
+    if (level > threshold) return 0;
+
+    stats.messages++;
+
+    if (policy[level] == LOG_BLOCK) {
+        log_drain(1);
+        console_write(msg, len);
+        return 0;
+    }
+
+    log_drain(0);
+
+    rb = (level <= LOG_PRIO_LEVEL) ? &prio_rb : &bulk_rb;
+
+    /*
+     * Straight to the console if nothing ahead of it is queued, priority
+     * messages jump ahead of queued bulk messages.
+     */
+    if (rb_is_cantget(&prio_rb) &&
+        ((rb == &prio_rb) || rb_is_cantget(&bulk_rb)) &&
+        (console_trywrite(msg, len) == 0))
+        return 0;
+
+    if ((len > LOG_MSG_SIZE) || (len >= (rb->limit - rb->start))) {
+        stats.dropped++;
+        return -1;
+    }
+
+    while ((rb->limit - rb->start) - rb_count(rb) < len + 1U) {
+        if (policy[level] != LOG_DROP_OLDEST) {
+            stats.dropped++;
+            return -1;
+        }
+
+        lane_drop(rb);
+        stats.dropped++;
+    }
+
+    rb_put(rb, &len);
+
+    while (len--) rb_put(rb, p++);
+
+    return 0;
+}
+
+
+/*
+ * poll, move queued messages to the console as space frees, call from the
+ * main loop
+ */
+void log_poll(void)
+{
+    log_drain(0);
+}
+
+
+void log_set_level(uint8_t level)
+{
+    threshold = level;
+}
+
+
+void log_set_policy(uint8_t level, uint8_t new_policy)
+{
+    if (level < LOG_LEVELS) policy[level] = new_policy;
+}
+
+
+void log_get_stats(struct log_stats * this_stats)
+{
+    *this_stats = stats;
+}
+
+
+void log_clear_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+
+void log_init(void)
+{
+    rb_init(&bulk_rb, bulk_buffer, sizeof(bulk_buffer));
+    rb_init(&prio_rb, prio_buffer, sizeof(prio_buffer));
+
+    threshold = LOG_INFO;
+
+    policy[LOG_CRIT] = LOG_BLOCK;
+    policy[LOG_ERR] = LOG_DROP_OLDEST;
+    policy[LOG_WARN] = LOG_DROP_OLDEST;
+    policy[LOG_INFO] = LOG_DROP_NEWEST;
+    policy[LOG_DEBUG] = LOG_DROP_NEWEST;
+
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <stdint.h>
+
+#include "fmt.h"
+
+/*
+ * Non-blocking log output.
+ *
+ *  A message is written straight to the console transmit ring-buffer when it
+ *  fits and nothing is queued ahead of it.  Otherwise it is queued in one of
+ *  two lanes, LOG_ERR and more severe in the priority lane, the rest in the
+ *  bulk lane, and moved to the console by log_poll as space frees.  The
+ *  priority lane is always served first, messages are moved whole so they
+ *  never interleave.
+ *
+ *  When a lane is full the level's policy decides:
+ *
+ *   LOG_BLOCK       - Wait for the console, queued messages go first.
+ *   LOG_DROP_NEWEST - Discard the new message.
+ *   LOG_DROP_OLDEST - Discard queued messages until the new one fits.
+ *
+ *  Only LOG_CRIT blocks by default.  Log from the main loop only, not from
+ *  interrupt handlers.
+ *
+ *      log_line(LOG_WARN, FMT_S("servo limit "), FMT_U(pulse_us), FMT_NL);
+ */
+#define LOG_CRIT  (0)
+#define LOG_ERR   (1)
+#define LOG_WARN  (2)
+#define LOG_INFO  (3)
+#define LOG_DEBUG (4)
+
+#define LOG_LEVELS (5)
+
+#define LOG_BLOCK       (0)
+#define LOG_DROP_NEWEST (1)
+#define LOG_DROP_OLDEST (2)
+
+/*
+ * Longest message that can be queued, longer messages are only written
+ * straight to the console.
+ */
+#ifndef LOG_MSG_SIZE
+#define LOG_MSG_SIZE FMT_LINE_SIZE
+#endif
+
+#define log_line(lvl,...) do {                                                 \
+    struct fmt _fmt;                                                           \
+    _fmt.len = 0;                                                              \
+    _fmt.level = (lvl);                                                        \
+    __VA_ARGS__;                                                               \
+    fmt_flush(&_fmt);                                                          \
+} while (0)
+
+struct log_stats {
+    uint16_t messages;
+    uint16_t dropped;
+};
+
+extern void log_init(void);
+extern void log_set_level(uint8_t level);
+extern void log_set_policy(uint8_t level, uint8_t policy);
+extern int8_t log_write(uint8_t level, void const * msg, uint8_t len);
+extern void log_poll(void);
+extern void log_get_stats(struct log_stats * this_stats);
+extern void log_clear_stats(void);
+
+#endif /* _LOG_H_ */
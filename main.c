@@ -23,29 +23,65 @@
 #include <util/atomic.h>
 #include <avr/pgmspace.h>
 #include <util/delay.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 #include "timer.h"
+#include "console.h"
 #include "tick.h"
 #include "tm1638.h"
-#include "bibase.h"
+#include "keyrep.h"
+#include "fmt.h"
+#include "log.h"
+#include "shell.h"
+#include "servo.h"
+#include "pid.h"
 #include "twi.h"
+#include "telemetry.h"
 
 
-#define PWM_FREQ    100U
-#define MIN_PULSE   500U  // in us
-#define MAX_PULSE   2500U // in us
+/* 1000 to 2000 us */
+static uint16_t pulse_us = (SERVO_MAX_PULSE + SERVO_MIN_PULSE) / 2;
 
-#define PWM_COUNTS  20000U
-#define MIN_COUNTS  (2 * MIN_PULSE)
-#define MAX_COUNTS  (2 * MAX_PULSE)
+/* last pulse_us shown and sent to the servo */
+static uint16_t written_us = UINT16_MAX;
 
-/* 1000 to 2000 us */
-static uint16_t pulse_us = (MAX_PULSE + MIN_PULSE) / 2;
+/* PID output display refresh, at most every PID_SHOW_TICKS */
+#define PID_SHOW_TICKS TBTICKS_FROM_MS(100)
+static tbtick_t pid_shown;
+static uint8_t pid_owned;
 
 static uint8_t brightness = TM1638_MAX_BRIGHTNESS / 2;
 
 static uint32_t keys = 0UL;
 
+/* pulse width step keys, 1000, 100, 10 and 1 us */
+#define KEYS_STEP_DOWN 0x22220000UL
+#define KEYS_STEP_UP   0x00002222UL
+
+/* time asleep in the main loop, and since when */
+static tbtick_t idle_ticks;
+static tbtick_t idle_since;
+
+/*
+ * Periodic servo telemetry, one record every telemetry_interval ticks, 0 is
+ * off.  Sent from the main loop on TELEMETRY_EV, a record is dropped if the
+ * previous frame is still queued.
+ */
+#define TELEMETRY_SERVO (1)
+
+struct telemetry_servo {
+    uint32_t tbtick;
+    uint16_t pulse_us;
+    uint16_t position;
+    uint16_t feedback;
+    uint16_t output;
+};
+
+static tbtick_t telemetry_interval;
+static uint32_t telemetry_sent;
+static uint32_t telemetry_dropped;
+
 static uint32_t process_keys(void)
 {
     uint32_t const new_keys = TM1638_get_keys();
@@ -59,37 +95,16 @@ static uint32_t process_keys(void)
 }
 
 
-void set_servo(uint16_t pulse_us)
-{
-    uint16_t pulse_counts;
-
-    if (0U == pulse_us)
-    {
-        pulse_counts = 0U;
-    }
-    else
-    {
-	    /* interpolate pulse width */
-	    pulse_counts = (uint16_t) (MIN_COUNTS + (((uint32_t) (pulse_us - MIN_PULSE)
-	                               * (uint32_t) (MAX_COUNTS - MIN_COUNTS))
-	                               / (uint32_t) (MAX_PULSE - MIN_PULSE)));
-    }
-
-    OCR1A = (PWM_COUNTS - 1) - pulse_counts;
-}
-
-
-static void update_servo(void)
+static void update_servo(uint8_t events)
 {
-    /* process button pushes */
-    uint32_t changed_buttons = process_keys();
+    /* process button pushes, only read when a key scan saw a change */
+    uint32_t changed_buttons = (events & TM1638_EV_KEYS) ? process_keys() : 0;
 
-#if 0
     if (0 != changed_buttons)
     {
-        printf("Button Down: %08lX\n", changed_buttons);
+        log_line(LOG_DEBUG, FMT_S("Button Down: "), FMT_X32(changed_buttons),
+                 FMT_NL);
     }
-#endif
 
     if (0x00000004 & changed_buttons)
     {
@@ -125,43 +140,54 @@ static void update_servo(void)
         TM1638_brightness(brightness);
     }
 
-    uint16_t new_pulse_us = pulse_us;
+    /* held step keys repeat */
+    uint8_t steps = 1;
 
-    if      (0x22220000 & changed_buttons)
+    if (events & TM1638_EV_KEYS)
     {
-        /*
-         * down button pressed
-         */
+        uint8_t const repeats = keyrep_scan(keys, changed_buttons,
+                                            TM1638_keys_tbtick());
 
-        if (0x00020000 & changed_buttons)
+        if (repeats)
         {
-            new_pulse_us = pulse_us - 1000;
+            changed_buttons = keyrep_keys();
+            steps = repeats;
         }
+    }
 
-        if (0x00200000 & changed_buttons)
-        {
-            new_pulse_us = pulse_us - 100;
-        }
+    uint16_t new_pulse_us = pulse_us;
+    int32_t step = 0;
 
-        if (0x02000000 & changed_buttons)
-        {
-            new_pulse_us = pulse_us - 10;
-        }
+    if ((KEYS_STEP_DOWN | KEYS_STEP_UP) & changed_buttons)
+    {
+        if (0x00020002 & changed_buttons) step = 1000;
+        if (0x00200020 & changed_buttons) step = 100;
+        if (0x02000200 & changed_buttons) step = 10;
+        if (0x20002000 & changed_buttons) step = 1;
 
-        if (0x20000000 & changed_buttons)
-        {
-            new_pulse_us = pulse_us - 1;
-        }
+        /* all the repeats since the last pass in one update */
+        step *= steps;
+    }
 
+    if      (KEYS_STEP_DOWN & changed_buttons)
+    {
         /*
-         * if adjusted RPM is less than minimum or underflowed
+         * down button pressed
          */
-        if ((new_pulse_us > pulse_us) || (new_pulse_us < MIN_PULSE))
+
+        /*
+         * if adjusted RPM is less than minimum
+         */
+        if (((int32_t) pulse_us - step) < SERVO_MIN_PULSE)
         {
             new_pulse_us = 0;
         }
+        else
+        {
+            new_pulse_us = pulse_us - step;
+        }
     }
-    else if (0x00002222 & changed_buttons)
+    else if (KEYS_STEP_UP & changed_buttons)
     {
         /*
          * up button pressed
@@ -169,210 +195,568 @@ static void update_servo(void)
 
         if (pulse_us == 0)
         {
-            new_pulse_us = MIN_PULSE;
+            new_pulse_us = SERVO_MIN_PULSE;
         }
-        else
+        else if (((int32_t) pulse_us + step) > SERVO_MAX_PULSE)
         {
-            if (0x00000002 & changed_buttons)
-            {
-                new_pulse_us = pulse_us + 1000;
-            }
-
-            if (0x00000020 & changed_buttons)
-            {
-                new_pulse_us = pulse_us + 100;
-            }
-
-            if (0x00000200 & changed_buttons)
-            {
-                new_pulse_us = pulse_us + 10;
-            }
-
-            if (0x00002000 & changed_buttons)
-            {
-                new_pulse_us = pulse_us + 1;
-            }
-
             /*
-             * if adjusted RPM is greater than maximum or overflowed
+             * if adjusted RPM is greater than maximum
              */
-            if ((new_pulse_us < pulse_us) || (new_pulse_us > MAX_PULSE))
-            {
-                new_pulse_us = MAX_PULSE;
-            }
+            new_pulse_us = SERVO_MAX_PULSE;
+        }
+        else
+        {
+            new_pulse_us = pulse_us + step;
+        }
+    }
+
+    if (pid_enabled())
+    {
+        /* the PID owns channel 0, the keys don't step it, show its output */
+        uint16_t const output_us = pid_output();
+
+        if ((output_us != written_us) &&
+            ((tbtick_t) (tbtick_get() - pid_shown) >= PID_SHOW_TICKS))
+        {
+            written_us = output_us;
+            pid_shown = tbtick_get();
+
+            TM1638_write_number(0, 4, output_us, 0);
         }
+
+        pid_owned = 1;
+
+        return;
+    }
+
+    if (pid_owned)
+    {
+        /* back from the PID, the servo is wherever it left it */
+        pid_owned = 0;
+        written_us = UINT16_MAX;
     }
 
     pulse_us = new_pulse_us;
 
-    uint8_t dec[4] = { 0, 0, 0, 0 };
+    if (pulse_us != written_us)
+    {
+        written_us = pulse_us;
+
+        TM1638_write_number(0, 4, pulse_us, 0);
+
+        servo_move(pulse_us);
+    }
+}
+
+/*
+ * HD44780 display on a PCF8574 port expander, 4-bit mode, the low nibble is
+ * the data, E and RS above it.
+ */
+#define HD44780_ADDRESS 0x20
+#define HD44780_E       0x10
+#define HD44780_RS      0x40
 
-    uint8_t n_digit = bibase(0, pulse_us >> 8, dec, 246);
-    n_digit = bibase(n_digit, pulse_us, dec, 246);
+/* transactions in flight */
+#define HD44780_QUEUE   4
 
-    TM1638_write_digit(3, (n_digit > 3) ? dec[3] : -1);
-    TM1638_write_digit(2, (n_digit > 2) ? dec[2] : -1);
-    TM1638_write_digit(1, (n_digit > 1) ? dec[1] : -1);
-    TM1638_write_digit(0, dec[0]);
+static struct twi_xfer hd44780_xfer[HD44780_QUEUE];
+static uint8_t hd44780_buf[HD44780_QUEUE][5];
+static uint8_t hd44780_next;
 
-    set_servo(pulse_us);
+
+/*
+ * Queue one byte as two nibbles strobing E.  Returns -1 if every transaction
+ * is still queued.
+ */
+static int8_t hd44780_write(uint8_t rs, uint8_t byte)
+{
+    struct twi_xfer * const xfer = &hd44780_xfer[hd44780_next];
+    uint8_t * const buf = hd44780_buf[hd44780_next];
+    uint8_t nibble;
+
+    if (xfer->status == TWI_PENDING) return -1;
+
+    nibble = rs | ((byte >> 4) & 0x0F);
+
+    buf[0] = nibble;
+    buf[1] = nibble | HD44780_E;
+    buf[2] = nibble;
+
+    nibble = rs | ( byte       & 0x0F);
+
+    buf[3] = nibble | HD44780_E;
+    buf[4] = nibble;
+
+    xfer->address = HD44780_ADDRESS;
+    xfer->wbuf = buf;
+    xfer->wlen = sizeof(hd44780_buf[0]);
+
+    twi_submit(xfer);
+
+    hd44780_next = (hd44780_next + 1) % HD44780_QUEUE;
+
+    return 0;
+}
+
+
+int8_t hd44780_write_data(uint8_t data)
+{
+    return hd44780_write(HD44780_RS, data);
 }
 
-void servo_init(void)
+
+int8_t hd44780_write_instr(uint8_t instr)
 {
-    /* initialize servo output pin */
-    pinmap_clear(SERVO_OUT);
-    pinmap_dir(0, SERVO_OUT);
-
-    // Timer 1, Fast PWM mode 14, WGM = 1:1:1:0, clk/8,
-    TCCR1A = 0xC2;  // COM1A1 = 1, COM1A0 = 0, WGM11 = 1, WGM10 = 0
-    TCCR1B = 0x1A;  // WGM13 = 1, WGM12 = 1, CS = 2
-    TCCR1C = 0x00;
-    ICR1 = PWM_COUNTS - 1;
-    OCR1A = (MAX_COUNTS - MIN_COUNTS) / 2;
+    return hd44780_write(0, instr);
 }
 
 
-uint8_t get_status(uint8_t command)
+/*
+ * Write raw port bytes and wait for them, for the reset sequence.
+ */
+static void hd44780_write_port(uint8_t const * buf, uint8_t len)
 {
-    uint8_t twcr;
-    uint8_t twsr;
+    struct twi_xfer xfer = {
+        .address = HD44780_ADDRESS,
+        .wbuf = buf,
+        .wlen = len,
+    };
+
+    twi_submit(&xfer);
+    twi_wait(&xfer);
+}
+
+
+/*
+ * Queue an instruction and give it 2 ms once it has been written.
+ */
+static void hd44780_setup(uint8_t instr)
+{
+    hd44780_write_instr(instr);
+    twi_wait(&hd44780_xfer[(hd44780_next + HD44780_QUEUE - 1)
+                           % HD44780_QUEUE]);
+    timer_delay(TBTICKS_FROM_MS(2));
+}
+
+
+void hd44780(void)
+{
+    static uint8_t const reset_8bit[] = { 0x00, 0x13, 0x03 };
+    static uint8_t const again_8bit[] = { 0x13, 0x03 };
+    static uint8_t const set_4bit[] = { 0x12, 0x02 };
+
+    timer_delay(TBTICKS_FROM_MS(15));
+
+    hd44780_write_port(reset_8bit, sizeof(reset_8bit));
+
+    timer_delay(TBTICKS_FROM_US(4100));
+
+    hd44780_write_port(again_8bit, sizeof(again_8bit));
+
+    timer_delay(TBTICKS_FROM_US(100));
+
+    hd44780_write_port(again_8bit, sizeof(again_8bit));
+
+    timer_delay(TBTICKS_FROM_MS(2));
+
+    hd44780_write_port(set_4bit, sizeof(set_4bit));
+
+    timer_delay(TBTICKS_FROM_MS(2));
+
+    hd44780_setup(0x28);
+    hd44780_setup(0x04);
+//    hd44780_setup(0x0C);
+    hd44780_setup(0x0E);
+    hd44780_setup(0x01);
+
+    for (uint8_t c = 0x20; c < 0x70; c++)
+    {
+        /* sleep until the oldest transaction is done if they are all queued */
+        while (hd44780_write_data(c) < 0)
+        {
+            twi_wait(&hd44780_xfer[hd44780_next]);
+        }
+    }
+}
+
+
+/*
+ * timer event for periodic telemetry
+ */
+TIMER_EVENT(telemetry_event, telemetry_handler);
+
+static int8_t telemetry_handler(struct timer_event * this_timer_event)
+{
+    GPIOR0 |= TELEMETRY_EV;
+
+    /* advance this timer */
+    this_timer_event->tbtick += telemetry_interval;
+
+    /* reschedule this timer */
+    return 1;
+}
+
+static void telemetry_poll(void)
+{
+    struct telemetry_servo record;
+
+    record.tbtick = tbtick_get();
+    record.pulse_us = pulse_us;
+    record.position = servo_position();
+    record.feedback = pid_feedback();
+    record.output = pid_output();
+
+    if (telemetry_send(TELEMETRY_SERVO, &record, sizeof(record)) < 0)
+    {
+        telemetry_dropped++;
+    }
+    else
+    {
+        telemetry_sent++;
+    }
+}
 
-    TWCR = command;
 
-    do
+/*
+ * console commands
+ */
+static int8_t cmd_baud(uint8_t argc, int32_t const * argv)
+{
+    if (argc != 1) return -1;
+
+#ifdef CONSOLE_AUTOBAUD
+    /* baud 0 measures a 'U' sent within two seconds, the longest allowed */
+    if (0 == argv[0])
     {
-        twcr = TWCR;
+        uint32_t baud;
+
+        fmt_line(FMT_S("send U\n"));
+
+        baud = console_autobaud(TBTICKS_FROM_MS(2000));
+
+        if (!baud) return -1;
+
+        fmt_line(FMT_S("baud "), FMT_U(baud), FMT_NL);
+
+        return 0;
     }
-    while (!(twcr & _BV(TWINT)));
+#endif
 
-    twsr = TWSR;
+    if (argv[0] <= 0) return -1;
 
-    return twsr;
+    return console_setbaud(argv[0]);
 }
 
+static int8_t cmd_bright(uint8_t argc, int32_t const * argv)
+{
+    if (argc != 1) return -1;
+
+    brightness = limit_range(0, argv[0], TM1638_MAX_BRIGHTNESS);
+    TM1638_brightness(brightness);
 
-void hd44780_write_data(uint8_t data)
+    return 0;
+}
+
+static int8_t cmd_help(uint8_t argc, int32_t const * argv)
 {
-    uint8_t status;
-    uint8_t nibble;
+    for (uint8_t i = 0; i < shell_commands_count; i++)
+    {
+        char name[SHELL_NAME_SIZE + 1];
+
+        memcpy_P(name, shell_commands[i].name, SHELL_NAME_SIZE);
+        name[SHELL_NAME_SIZE] = '\0';
+
+        fmt_line(FMT_STR(name), FMT_NL);
+    }
+
+    return 0;
+}
+
+static int8_t cmd_log(uint8_t argc, int32_t const * argv)
+{
+    if (argc != 1) return -1;
+
+    log_set_level(limit_range(LOG_CRIT, argv[0], LOG_DEBUG));
+
+    return 0;
+}
+
+static int8_t cmd_repeat(uint8_t argc, int32_t const * argv)
+{
+    struct keyrep_params kp;
 
-    status = get_status(_BV(TWINT) | _BV(TWSTA) | _BV(TWEN));
-    TWDR   = 0x40;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
+    if ((argc < 1) || (argc > 4)) return -1;
 
-    nibble = 0x40 | ((data >> 4) & 0x0F);
+    keyrep_get_params(&kp);
 
-    TWDR   = nibble;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
-    TWDR   = nibble | 0x10;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
-    TWDR   = nibble;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
+    kp.delay = TBTICKS_FROM_MS(limit_range(0, argv[0], 5000));
 
-    nibble = 0x40 | ( data       & 0x0F);
+    if (argc > 1)
+    {
+        kp.interval = TBTICKS_FROM_MS(limit_range(1, argv[1], 5000));
+    }
+
+    if (argc > 2)
+    {
+        kp.min = TBTICKS_FROM_MS(limit_range(1, argv[2], 5000));
+    }
+
+    if (argc > 3)
+    {
+        kp.accel = limit_range(0, argv[3], 255);
+    }
 
-    TWDR   = nibble | 0x10;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
-    TWDR   = nibble;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
+    keyrep_set_params(&kp);
 
-    TWCR   = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
-    while (TWCR & _BV(TWSTO));
+    return 0;
 }
 
+static int8_t cmd_scan(uint8_t argc, int32_t const * argv)
+{
+    if (argc != 1) return -1;
+
+    TM1638_keys_interval(limit_range(0, argv[0], 255));
+
+    return 0;
+}
 
-void hd44780_write_instr(uint8_t instr)
+static int8_t cmd_servo(uint8_t argc, int32_t const * argv)
 {
-    uint8_t status;
-    uint8_t nibble;
+    uint16_t pulse;
 
-    status = get_status(_BV(TWINT) | _BV(TWSTA) | _BV(TWEN));
-    TWDR   = 0x40;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
+    if ((argc < 1) || (argc > 2)) return -1;
 
-    nibble = (instr >> 4) & 0x0F;
+    pulse = (argv[argc - 1] <= 0) ? 0 :
+            limit_range(SERVO_MIN_PULSE, argv[argc - 1], SERVO_MAX_PULSE);
 
-    TWDR   = nibble;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
-    TWDR   = nibble | 0x10;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
-    TWDR   = nibble;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
+    if ((argc == 1) || (argv[0] == 0))
+    {
+        /* channel 0, profiled, written by update_servo, unless the PID has it */
+        if (pid_enabled()) return -1;
 
-    nibble =  instr       & 0x0F;
+        pulse_us = pulse;
+    }
+    else
+    {
+        if ((argv[0] < 0) || (argv[0] >= SERVO_CHANNELS)) return -1;
 
-    TWDR   = nibble | 0x10;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
-    TWDR   = nibble;
-    status = get_status(_BV(TWINT) |              _BV(TWEN));
+        servo_pulse(argv[0], pulse);
+    }
 
-    TWCR   = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
-    while (TWCR & _BV(TWSTO));
+    return 0;
 }
 
+static int8_t cmd_pid(uint8_t argc, int32_t const * argv)
+{
+    if (argc > 4) return -1;
 
-void hd44780(void)
+    if (argc == 0)
+    {
+        fmt_line(FMT_S("pid "), FMT_STR(pid_enabled() ? "on" : "off"),
+                 FMT_S(", feedback "), FMT_U(pid_feedback()),
+                 FMT_S(", output "), FMT_U(pid_output()),
+                 FMT_S(" us\n"));
+
+        return 0;
+    }
+
+    if (argv[0] < 0)
+    {
+        pid_enable(0);
+
+        return 0;
+    }
+
+    if (argc == 4)
+    {
+        pid_gains(limit_range(INT16_MIN, argv[1], INT16_MAX),
+                  limit_range(INT16_MIN, argv[2], INT16_MAX),
+                  limit_range(INT16_MIN, argv[3], INT16_MAX));
+    }
+    else if (argc != 1)
+    {
+        return -1;
+    }
+
+    pid_setpoint(limit_range(0, argv[0], 1023));
+    pid_enable(1);
+
+    return 0;
+}
+
+static int8_t cmd_profile(uint8_t argc, int32_t const * argv)
 {
-    uint8_t status;
+    if ((argc < 2) || (argc > 3)) return -1;
 
-    timer_delay(TBTICKS_FROM_MS(15));
+    servo_limits(limit_range(1, argv[0], SERVO_MAX_VELOCITY),
+                 limit_range(1, argv[1], SERVO_MAX_ACCEL),
+                 (argc > 2) ? limit_range(0, argv[2], INT32_MAX) : 0);
 
-    status = get_status(_BV(TWINT) | _BV(TWSTA) | _BV(TWEN));
-    TWDR   = 0x40;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
-    TWDR   = 0x00;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
-    TWDR   = 0x13;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
-    TWDR   = 0x03;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
+    return 0;
+}
 
-    timer_delay(TBTICKS_FROM_US(4100));
+/*
+ * Percentage of the time since the stats were cleared spent asleep.
+ */
+static uint8_t idle_percent(void)
+{
+    tbtick_t const elapsed = tbtick_get() - idle_since;
 
-    TWDR   = 0x13;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
-    TWDR   = 0x03;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
+    if (elapsed < 100) return 0;
 
-    timer_delay(TBTICKS_FROM_US(100));
+    return min(idle_ticks / (elapsed / 100), 100);
+}
 
-    TWDR   = 0x13;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
-    TWDR   = 0x03;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
+static int8_t cmd_stats(uint8_t argc, int32_t const * argv)
+{
+    struct timer_stats ts;
+    struct shell_stats ss;
+    struct log_stats ls;
+    struct pid_stats ps;
+
+    timer_get_stats(&ts);
+    shell_get_stats(&ss);
+    log_get_stats(&ls);
+    pid_get_stats(&ps);
+
+    fmt_line(FMT_S("timer events "), FMT_U(ts.events),
+             FMT_S(", max late "), FMT_U(US_FROM_TBTICKS(ts.max_late)),
+             FMT_S(" us\n"));
+    fmt_line(FMT_S("command latency "), FMT_U(US_FROM_TBTICKS(ss.last_latency)),
+             FMT_S(" us, max "), FMT_U(US_FROM_TBTICKS(ss.max_latency)),
+             FMT_S(" us\n"));
+    fmt_line(FMT_S("log messages "), FMT_U(ls.messages),
+             FMT_S(", dropped "), FMT_U(ls.dropped), FMT_NL);
+    fmt_line(FMT_S("idle "), FMT_U(idle_percent()), FMT_S("%\n"));
+    fmt_line(FMT_S("pid steps "), FMT_U(ps.steps),
+             FMT_S(", overruns "), FMT_U(ps.overruns),
+             FMT_S(", max late "), FMT_U(US_FROM_TBTICKS(ps.max_late)),
+             FMT_S(" us, max cost "), FMT_U(US_FROM_TBTICKS(ps.max_cost)),
+             FMT_S(" us\n"));
+
+    if (argc && argv[0] == 0)
+    {
+        timer_clear_stats();
+        log_clear_stats();
+        pid_clear_stats();
+        idle_ticks = 0;
+        idle_since = tbtick_get();
+    }
 
-    timer_delay(TBTICKS_FROM_MS(2));
+    return 0;
+}
 
-    TWDR   = 0x12;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
-    TWDR   = 0x02;
-    status = get_status(_BV(TWINT) | _BV(TWEN));
+static int8_t cmd_telem(uint8_t argc, int32_t const * argv)
+{
+    if (argc > 1) return -1;
 
-    TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
-    while (TWCR & _BV(TWSTO));
+    if (argc)
+    {
+        /* stopped before the interval changes, the handler reads it */
+        cancel_timer_event(&telemetry_event);
 
-    timer_delay(TBTICKS_FROM_MS(2));
+        telemetry_interval = TBTICKS_FROM_MS(limit_range(0, argv[0], 60000));
 
-    hd44780_write_instr(0x28);
-    timer_delay(TBTICKS_FROM_MS(2));
+        if (telemetry_interval)
+        {
+            telemetry_event.tbtick = telemetry_interval;
+            schedule_timer_event(&telemetry_event, NULL);
+        }
+    }
 
-    hd44780_write_instr(0x04);
-    timer_delay(TBTICKS_FROM_MS(2));
+    fmt_line(FMT_S("telem sent "), FMT_U(telemetry_sent),
+             FMT_S(", dropped "), FMT_U(telemetry_dropped), FMT_NL);
 
-//    hd44780_write_instr(0x0C);
-//    timer_delay(TBTICKS_FROM_MS(2));
+    return 0;
+}
 
-    hd44780_write_instr(0x0E);
-    timer_delay(TBTICKS_FROM_MS(2));
+static int8_t cmd_tick(uint8_t argc, int32_t const * argv)
+{
+    if (argc != 1) return -1;
 
-    hd44780_write_instr(0x01);
-    timer_delay(TBTICKS_FROM_MS(2));
+    if (argv[0] <= 0)
+    {
+        tick_enable(0);
+    }
+    else
+    {
+        tick_set_period(TBTICKS_FROM_MS(argv[0]));
+        tick_enable(1);
+    }
 
-    for (uint8_t c = 0x20; c < 0x70; c++)
+    return 0;
+}
+
+static int8_t cmd_uart(uint8_t argc, int32_t const * argv)
+{
+    struct console_stats cs;
+
+    console_get_stats(&cs);
+
+    fmt_line(FMT_S("rx "), FMT_U(cs.rx_bytes),
+             FMT_S(" bytes, high "), FMT_U(cs.rx_high),
+             FMT_S(", overrun "), FMT_U(cs.rx_overrun),
+             FMT_S(", frame "), FMT_U(cs.rx_frame),
+             FMT_S(", parity "), FMT_U(cs.rx_parity),
+             FMT_S(", dropped "), FMT_U(cs.rx_dropped), FMT_NL);
+    fmt_line(FMT_S("tx "), FMT_U(cs.tx_bytes),
+             FMT_S(" bytes, high "), FMT_U(cs.tx_high),
+             FMT_S(", blocked "), FMT_U(US_FROM_TBTICKS(cs.tx_blocked) / 1000),
+             FMT_S(" ms\n"));
+
+    if (argc && argv[0] == 0)
     {
-        hd44780_write_data(c);
+        console_clear_stats();
     }
+
+    return 0;
+}
+
+/* sorted by name */
+const struct shell_command shell_commands[] PROGMEM = {
+    SHELL_COMMAND("baud",    cmd_baud),
+    SHELL_COMMAND("bright",  cmd_bright),
+    SHELL_COMMAND("help",    cmd_help),
+    SHELL_COMMAND("log",     cmd_log),
+    SHELL_COMMAND("pid",     cmd_pid),
+    SHELL_COMMAND("profile", cmd_profile),
+    SHELL_COMMAND("repeat",  cmd_repeat),
+    SHELL_COMMAND("scan",    cmd_scan),
+    SHELL_COMMAND("servo",   cmd_servo),
+    SHELL_COMMAND("stats",   cmd_stats),
+    SHELL_COMMAND("telem",   cmd_telem),
+    SHELL_COMMAND("tick",    cmd_tick),
+    SHELL_COMMAND("uart",    cmd_uart),
+};
+
+const uint8_t shell_commands_count = ARRAY_SIZE(shell_commands);
+
+
+/*
+ * Sleep until an interrupt if no main loop event is pending.  Any interrupt
+ * wakes the CPU, the loop goes back to sleep if it did not set an event.  The
+ * time asleep includes the interrupt that ends it.
+ */
+static void idle_wait(void)
+{
+    tbtick_t start;
+
+    cli();
+
+    if (GPIOR0 & MAIN_EVENTS)
+    {
+        sei();
+        return;
+    }
+
+    start = tbtick_update();
+
+    SMCR = SLEEP_MODE_IDLE | _BV(SE);
+    sei();
+    sleep_cpu();
+    SMCR = SLEEP_MODE_IDLE;
+
+    idle_ticks += tbtick_get() - start;
 }
 
 
@@ -386,6 +770,7 @@ void main(void)
         tbtick_init();
         tick_init();
         servo_init();
+        pid_init();
         twi_init();
     }
     /* interrupts are enabled */
@@ -396,10 +781,44 @@ void main(void)
     TM1638_init(10);
     TM1638_enable(1);
 
+    /* the pulse width step keys repeat while held */
+    keyrep_init(KEYS_STEP_DOWN | KEYS_STEP_UP);
+
+    shell_init();
+    log_init();
+
+    idle_since = tbtick_get();
+
     for (;;)
     {
-        /* read keys and update servo */
-        update_servo();
+        uint8_t events;
+
+        /* take the pending events */
+        ATOMIC_BLOCK(ATOMIC_FORCEON)
+        {
+            events = GPIOR0 & MAIN_EVENTS;
+            GPIOR0 &= ~events;
+        }
+
+        /* run console commands */
+        if (events & CONSOLE_EV_RX)
+        {
+            shell_poll();
+        }
+
+        /* send a telemetry record when one is due */
+        if (events & TELEMETRY_EV)
+        {
+            telemetry_poll();
+        }
+
+        /* read keys if they changed and update servo */
+        update_servo(events);
+
+        /* move queued log messages to the console, after any wake up */
+        log_poll();
+
+        idle_wait();
     }
 }
 
@@ -0,0 +1,286 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "project.h"
+
+#include <string.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "timer.h"
+#include "servo.h"
+#include "pid.h"
+
+
+/*
+ * Step period in timebase ticks, PID_TICKS plus one every PID_HZ / PID_REM
+ * steps, 62.5 at 16 MHz.
+ */
+#define TBTICK_HZ   (F_CPU / TBTIMER_PRESCALER)
+#define PID_TICKS   (TBTICK_HZ / PID_HZ)
+#define PID_REM     (TBTICK_HZ % PID_HZ)
+
+/* ADC clock F_CPU / 128, a conversion takes 13 ADC clocks */
+#define PID_ADCSRA  (_BV(ADEN) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))
+
+#if (PID_ADC_CHANNEL > 7)
+#error "PID_ADC_CHANNEL invalid; set to 0 through 7."
+#elif (PID_ADC_CHANNEL < 6) && !PID_FEEDBACK
+#error "PID_FEEDBACK unset; set to the pin of ADC0-5."
+#endif
+
+static int16_t kp;
+static int16_t ki;
+static int16_t kd;
+static int16_t setpoint;
+static int16_t feedback;
+static int16_t last_feedback;     /* -1 until the first step */
+static int32_t integral;
+static int32_t integral_limit;
+static uint16_t out_min = SERVO_MIN_PULSE;
+static uint16_t out_max = SERVO_MAX_PULSE;
+static uint16_t output;
+static uint16_t phase;
+
+static struct pid_stats stats;
+
+
+/*
+ * One control step, in the timebase interrupt.
+ */
+static int8_t pid_handler(struct timer_event * this_timer_event)
+{
+    tbtick_t const start = tbtick_update();
+    tbtick_st const late = start - this_timer_event->tbtick;
+    tbtick_t cost;
+    int32_t const last_integral = integral;
+    int32_t step;
+    int32_t u;
+    int16_t e;
+
+    stats.steps++;
+    if (late > stats.max_late) stats.max_late = late;
+
+    /* feedback, converted since the last step, then start the next */
+    if (!(ADCSRA & _BV(ADSC))) feedback = ADC;
+    ADCSRA |= _BV(ADSC);
+
+    /* no derivative on the first step, there is no last feedback */
+    if (last_feedback < 0) last_feedback = feedback;
+
+    e = setpoint - feedback;
+
+    /* integrate, clamped to the output span */
+    step = (int32_t) ki * e;
+    integral = limit_range(-integral_limit, integral + step, integral_limit);
+
+    u = (int32_t) kp * e + integral
+      + (int32_t) kd * (last_feedback - feedback);
+    last_feedback = feedback;
+
+    u = (u >> PID_FRAC) + ((out_min + out_max) / 2);
+
+    /*
+     * Clamp the output, and don't wind up the integral against the limit,
+     * the step is undone as the clamp to the span may have changed it.
+     */
+    if (u > out_max)
+    {
+        u = out_max;
+        if (step > 0) integral = last_integral;
+    }
+    else if (u < out_min)
+    {
+        u = out_min;
+        if (step < 0) integral = last_integral;
+    }
+
+    if (u != output)
+    {
+        output = u;
+        servo_set(output);
+    }
+
+    /* advance this timer, PID_TICKS and the remainder spread over the steps */
+    this_timer_event->tbtick += PID_TICKS;
+    phase += PID_REM;
+
+    if (phase >= PID_HZ)
+    {
+        phase -= PID_HZ;
+        this_timer_event->tbtick++;
+    }
+
+    /* overrun, the next step is already due, skip it */
+    if ((tbtick_st) (tbtick_update() - this_timer_event->tbtick) >= 0)
+    {
+        stats.overruns++;
+        this_timer_event->tbtick = tbtick_update() + PID_TICKS;
+    }
+
+    cost = tbtick_update() - start;
+    if (cost > stats.max_cost) stats.max_cost = cost;
+
+    /* reschedule this timer */
+    return 1;
+}
+
+static struct timer_event pid_event = {
+    .next = &pid_event,
+    .handler = pid_handler,
+};
+
+
+void pid_enable(uint8_t enable)
+{
+    if (timer_is_expired(&pid_event))
+    {
+        if (enable)
+        {
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                /* the first step seeds the derivative, integral empty */
+                last_feedback = -1;
+                integral = 0;
+                output = 0;
+                phase = 0;
+            }
+
+            /*
+             * Conversion for the first step, unless one is still running,
+             * no wait.
+             */
+            ADCSRA |= _BV(ADSC);
+
+            pid_event.tbtick = PID_TICKS;
+            schedule_timer_event(&pid_event, NULL);
+        }
+    }
+    else
+    {
+        if (!enable)
+        {
+            cancel_timer_event(&pid_event);
+        }
+    }
+}
+
+
+uint8_t pid_enabled(void)
+{
+    return !timer_is_expired(&pid_event);
+}
+
+
+/*
+ * Setpoint in ADC counts.
+ */
+void pid_setpoint(uint16_t new_setpoint)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        setpoint = min(new_setpoint, 1023U);
+    }
+}
+
+
+void pid_gains(int16_t new_kp, int16_t new_ki, int16_t new_kd)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        kp = new_kp;
+        ki = new_ki;
+        kd = new_kd;
+        integral = 0;
+    }
+}
+
+
+/*
+ * Output range in us, within SERVO_MIN_PULSE to SERVO_MAX_PULSE.
+ */
+void pid_limits(uint16_t min_us, uint16_t max_us)
+{
+    min_us = limit_range(SERVO_MIN_PULSE, min_us, SERVO_MAX_PULSE);
+    max_us = limit_range(min_us, max_us, SERVO_MAX_PULSE);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        out_min = min_us;
+        out_max = max_us;
+        integral_limit = (int32_t) (max_us - min_us) << PID_FRAC;
+        integral = 0;
+    }
+}
+
+
+uint16_t pid_feedback(void)
+{
+    uint16_t fb;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        fb = feedback;
+    }
+
+    return fb;
+}
+
+
+uint16_t pid_output(void)
+{
+    uint16_t out;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        out = output;
+    }
+
+    return out;
+}
+
+
+void pid_get_stats(struct pid_stats * this_stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *this_stats = stats;
+    }
+}
+
+
+void pid_clear_stats(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+}
+
+
+void pid_init(void)
+{
+    /* feedback input, AVcc reference */
+    pinmap_set_did(PID_FEEDBACK);
+    ADMUX = _BV(REFS0) | PID_ADC_CHANNEL;
+
+    /* a first conversion so pid_feedback has a reading before pid_enable */
+    ADCSRA = PID_ADCSRA | _BV(ADSC);
+
+    pid_limits(SERVO_MIN_PULSE, SERVO_MAX_PULSE);
+    pid_gains(1 << PID_FRAC, 0, 0);
+    pid_setpoint(512);
+}
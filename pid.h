@@ -0,0 +1,70 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _PID_H_
+#define _PID_H_
+
+#include <stdint.h>
+
+/*
+ * Control loop rate.
+ */
+#define PID_HZ 1000U
+
+/*
+ * Gains are Q8.8, applied to the error in ADC counts per step, the output is
+ * a servo pulse width in us.
+ */
+#define PID_FRAC 8
+
+/*
+ * Loop statistics, max_late is how far the step ran after its tick and
+ * max_cost how long the step took, both in timebase ticks.  An overrun is a
+ * step that finished after the next one was due, that step is skipped.
+ */
+struct pid_stats {
+    uint32_t steps;
+    uint16_t overruns;
+    uint16_t max_late;
+    uint16_t max_cost;
+};
+
+/*
+ * Fixed-point PID controller closing the servo, channel 0, on an ADC input.
+ *
+ *  A timer event runs each step at PID_HZ from the timebase interrupt.  The
+ *  step reads the conversion started by the previous step, so the feedback
+ *  is one step old, and starts the next one.  The derivative is taken on the
+ *  feedback, not the error, so a setpoint change does not kick the output.
+ *  The output is clamped to the pid_limits range, the integral is clamped to
+ *  that span and stops integrating while the output is held at a limit.
+ *
+ *  The step is a fixed sequence, three 16x16 multiplies and no division or
+ *  loops, plus servo_set when the output changes.  The servo latches it at
+ *  the next 100 Hz frame.  While enabled the PID owns channel 0.
+ */
+extern void pid_init(void);
+extern void pid_enable(uint8_t enable);
+extern uint8_t pid_enabled(void);
+extern void pid_setpoint(uint16_t setpoint);
+extern void pid_gains(int16_t kp, int16_t ki, int16_t kd);
+extern void pid_limits(uint16_t min_us, uint16_t max_us);
+extern uint16_t pid_feedback(void);
+extern uint16_t pid_output(void);
+extern void pid_get_stats(struct pid_stats * this_stats);
+extern void pid_clear_stats(void);
+
+#endif /* _PID_H_ */
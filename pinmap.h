@@ -17,6 +17,8 @@
 #ifndef _PINMAP_H_
 #define _PINMAP_H_
 
+#include <avr/io.h>
+
 #include "bits.h"
 
 #include <stdint.h>
@@ -332,6 +334,29 @@ static __inline void pinmap_clear_did(pinmap_t pinmap)
     if (pinmap & (0x3fUL << 16)) bitmask_clear(&DIDR0, (pinmap >> 16) & 0x3f);
 }
 
+static __inline void pinmap_set_pcint(pinmap_t pinmap)
+{
+    if (pinmap & (0xffUL << 24)) {
+        bitmask_set(&PCMSK2, pinmap >> 24);
+        bitmask_set(&PCICR, _BV(PCIE2));
+    }
+    if (pinmap & (0x7fUL << 16)) {
+        bitmask_set(&PCMSK1, (pinmap >> 16) & 0x7f);
+        bitmask_set(&PCICR, _BV(PCIE1));
+    }
+    if (pinmap & (0xffUL <<  8)) {
+        bitmask_set(&PCMSK0, pinmap >>  8);
+        bitmask_set(&PCICR, _BV(PCIE0));
+    }
+}
+
+static __inline void pinmap_clear_pcint(pinmap_t pinmap)
+{
+    if (pinmap & (0xffUL << 24)) bitmask_clear(&PCMSK2, pinmap >> 24);
+    if (pinmap & (0x7fUL << 16)) bitmask_clear(&PCMSK1, (pinmap >> 16) & 0x7f);
+    if (pinmap & (0xffUL <<  8)) bitmask_clear(&PCMSK0, pinmap >>  8);
+}
+
 static __inline void pinmap_dir(pinmap_t inmap, pinmap_t outmap)
 {
     if (inmap) pinmap_clear_ddr(inmap);
@@ -48,7 +48,30 @@
 #define BAUD (9600UL)
 #endif
 
+#ifndef TX_BUF_SIZE
 #define TX_BUF_SIZE (128)
+#endif
+
+/* measure a 'U' sync character to set the baud rate, console_autobaud() */
+//#define CONSOLE_AUTOBAUD
+
+/*
+ * console flow control, CONSOLE_FLOW_NONE, CONSOLE_FLOW_XONXOFF or
+ * CONSOLE_FLOW_RTSCTS
+ */
+#define CONSOLE_FLOW_NONE    (0)
+#define CONSOLE_FLOW_XONXOFF (1)
+#define CONSOLE_FLOW_RTSCTS  (2)
+
+#ifndef CONSOLE_FLOW
+#define CONSOLE_FLOW CONSOLE_FLOW_NONE
+#endif
+
+/*
+ * log output lanes, see log.h
+ */
+#define LOG_BUF_SIZE  (96)
+#define LOG_PRIO_SIZE (32)
 
 /*
  * I2C interface
@@ -68,8 +91,27 @@
 #define TM1638_STB_HIGH()   pinmap_set(TM1638_STB)
 #define TM1638_STB_LOW()    pinmap_clear(TM1638_STB)
 
-/* Servo PWM output */
-#define SERVO_OUT PINMAP_OC1A
+/* Console hardware flow control, both active low */
+#define CONSOLE_RTS PINMAP_D2
+#define CONSOLE_CTS PINMAP_D3
+#define CONSOLE_CTS_vect PCINT2_vect
+
+/* Servo PWM outputs, channels 0 and 1, OC1B is also the SPI SS output */
+#define SERVO_OUT   PINMAP_OC1A
+#define SERVO_OUT_B PINMAP_OC1B
+
+/* Software servo outputs, channels 2 and up */
+#define SERVO_SOFT_PINS { PINMAP_D5, PINMAP_D7, PINMAP_D8, PINMAP_A0,          \
+                          PINMAP_A1, PINMAP_A2 }
+#define SERVO_CHANNELS  (8)
+
+/*
+ * PID feedback ADC channel, and its pin to turn the digital input off.  ADC3
+ * on A3, ADC0-5 are on every package.  ADC6 and ADC7 are only on the TQFP
+ * and QFN packages, analog only, and take a PID_FEEDBACK of 0.
+ */
+#define PID_ADC_CHANNEL (3)
+#define PID_FEEDBACK    PINMAP_ADC3
 
 
 /*
@@ -86,9 +128,20 @@
 
 #define TIMER1_PRESCALER (8UL)
 
+/* servo software edge alarm, 2 us ticks */
+#define TIMER2_PRESCALER (32UL)
+
 
 /* GPIOR0 event bits */
 #define TM1638_EV_BUSY           _BV(GPIOR00)
+#define CONSOLE_EV_SLOW_BIT      GPIOR01
+#define CONSOLE_EV_SLOW          _BV(CONSOLE_EV_SLOW_BIT)
+#define TM1638_EV_KEYS           _BV(GPIOR02)
+#define CONSOLE_EV_RX            _BV(GPIOR03)
+#define TELEMETRY_EV             _BV(GPIOR04)
+
+/* events the main loop sleeps waiting for */
+#define MAIN_EVENTS              (TM1638_EV_KEYS | CONSOLE_EV_RX | TELEMETRY_EV)
 
 
 /*
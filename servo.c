@@ -0,0 +1,610 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "project.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "timers.h"
+#include "servo.h"
+
+
+#define PWM_COUNTS  20000U
+#define PWM_TOP     (PWM_COUNTS - 1)
+#define MIN_COUNTS  (2 * SERVO_MIN_PULSE)
+#define MAX_COUNTS  (2 * SERVO_MAX_PULSE)
+
+/*
+ * Software edges.  The timer 2 alarm wakes SERVO_EDGE_LEAD counts, more than
+ * the interrupt entry, before an edge and polls TCNT1 up to it.  Edges closer
+ * than SERVO_EDGE_MERGE counts are polled in the same interrupt.  Counts are
+ * timer 1 counts, EDGE_TICK_COUNTS to a timer 2 tick.
+ */
+#define SERVO_EDGE_LEAD  8
+#define SERVO_EDGE_MERGE 16
+
+#define EDGE_TICK_COUNTS (TIMER2_PRESCALER / TIMER1_PRESCALER)
+#define EDGE_MAX_TICKS   (250)
+
+/* channels 0 and 1 are OC1A and OC1B, the rest are software */
+#define SOFT_CHANNELS (SERVO_CHANNELS - 2)
+
+/* PWM frame rate, 100 Hz */
+#define FRAME_HZ    (F_CPU / TIMER1_PRESCALER / PWM_COUNTS)
+
+/*
+ * Trapezoid motion state in counts with SERVO_FRAC fraction bits, per frame.
+ */
+#define SERVO_FRAC  12
+
+static int32_t position;
+static int32_t velocity;
+static int32_t target;
+static volatile uint8_t moving;
+
+/*
+ * S-curve filter, the output is the average of the last 1 << ramp_shift
+ * trapezoid positions.  A trapezoid averaged over N frames is an S-curve with
+ * the acceleration ramped over N frames, jerk a / N, or 2a / N where the
+ * acceleration reverses without a cruise between, and it still ends
+ * exactly on the target, N frames after the trapezoid.
+ */
+#define SERVO_RAMP_SHIFT_MAX 4
+
+static int32_t history[1 << SERVO_RAMP_SHIFT_MAX];
+static int32_t history_sum;
+static uint8_t history_index;
+static uint8_t ramp_shift;
+static uint8_t ramp_frames = 1;
+
+/*
+ * Limits in the same units.
+ */
+static uint32_t max_velocity;
+static uint32_t max_accel;
+
+/*
+ * Software channel frame, the pins to raise at the start of the frame and
+ * the falling edges sorted by pulse width, channels ending together share an
+ * edge.
+ */
+struct servo_edges {
+    pinmap_t rise;
+    uint8_t count;
+    uint16_t at[SOFT_CHANNELS];
+    pinmap_t fall[SOFT_CHANNELS];
+};
+
+static pinmap_t const soft_pins[SOFT_CHANNELS] = SERVO_SOFT_PINS;
+static uint16_t soft_counts[SOFT_CHANNELS];
+
+/*
+ * Double buffered, servo_pulse builds the back frame and sets edges_pending,
+ * the capture interrupt swaps them at the start of the next frame.
+ */
+static struct servo_edges edges[2];
+static struct servo_edges * edges_front = &edges[0];
+static struct servo_edges * edges_back = &edges[1];
+static volatile uint8_t edges_pending;
+static uint8_t edge_next;
+
+/* TCNT1 when the software channels rose, their edges are timed from it */
+static uint16_t frame_start;
+
+
+/*
+ * Pulse width scale factors in 16.16 fixed point, the division is done by
+ * the compiler so converting is a multiply and a shift.
+ */
+#define COUNTS_PER_US ((((uint32_t) (MAX_COUNTS - MIN_COUNTS)) << 16)        \
+                       / (SERVO_MAX_PULSE - SERVO_MIN_PULSE))
+#define US_PER_COUNT  ((((uint32_t) (SERVO_MAX_PULSE - SERVO_MIN_PULSE)) << 16)\
+                       / (MAX_COUNTS - MIN_COUNTS))
+
+
+static uint16_t counts_from_us(uint16_t pulse_us)
+{
+    if (0U == pulse_us)
+    {
+        return 0U;
+    }
+
+    /* interpolate pulse width */
+    return (uint16_t) (MIN_COUNTS + (((uint32_t) (pulse_us - SERVO_MIN_PULSE)
+                       * COUNTS_PER_US + 0x8000UL) >> 16));
+}
+
+
+static uint16_t us_from_counts(uint16_t counts)
+{
+    if (0U == counts)
+    {
+        return 0U;
+    }
+
+    return (uint16_t) (SERVO_MIN_PULSE + (((uint32_t) (counts - MIN_COUNTS)
+                       * US_PER_COUNT + 0x8000UL) >> 16));
+}
+
+
+/*
+ * Inverting fast PWM, the pulse runs from the compare to TOP and a compare
+ * at TOP holds the output low.  OCR1A is double buffered, the new width
+ * starts with the next frame.  Called with interrupts disabled.
+ */
+static void write_counts(uint16_t counts)
+{
+    OCR1A = PWM_TOP - counts;
+}
+
+
+/*
+ * Stopping test, true if moving u this frame then decelerating at the limit
+ * stops within d:
+ *
+ *  u + (u - a) + (u - 2a) + ... ~ u^2 / 2a + u / 2 <= d
+ *
+ * rearranged as u^2 + u a <= 2 a d to avoid division.  d has 6 fraction
+ * bits.  Products are taken with u, a and the fraction of d scaled to 6
+ * fraction bits so both sides have SERVO_FRAC, and saturate on overflow,
+ * which only slows early.
+ */
+#define STOP_FRAC   (SERVO_FRAC / 2)
+#define STOP_MASK   ((1UL << STOP_FRAC) - 1)
+
+static uint8_t can_stop(uint32_t u, uint32_t d)
+{
+    uint32_t const s = u >> STOP_FRAC;
+    uint32_t const a = max_accel >> STOP_FRAC;
+    uint32_t lhs;
+    uint32_t rhs;
+    uint32_t t;
+
+    if (__builtin_mul_overflow(s, s, &lhs) ||
+        __builtin_mul_overflow(s, a, &t) ||
+        __builtin_add_overflow(lhs, t, &lhs))
+    {
+        return 0;
+    }
+
+    if (__builtin_mul_overflow(2 * max_accel, d >> STOP_FRAC, &rhs) ||
+        __builtin_add_overflow(rhs, 2 * a * (d & STOP_MASK), &rhs))
+    {
+        return 1;
+    }
+
+    return lhs <= rhs;
+}
+
+
+/*
+ * Fill the S-curve filter with one position.
+ */
+static void history_fill(int32_t p)
+{
+    for (uint8_t i = 0; i < ARRAY_SIZE(history); i++)
+    {
+        history[i] = p;
+    }
+
+    history_sum = p << ramp_shift;
+    history_index = 0;
+}
+
+
+/*
+ * One frame of motion.  A fixed sequence of 32-bit multiplies and adds, no
+ * division and no loops.
+ */
+static void servo_step(void)
+{
+    int32_t const err = target - position;
+    uint32_t const dist = labs(err) >> (SERVO_FRAC - STOP_FRAC);
+    uint32_t const speed = labs(velocity);
+    int32_t const dir = (err < 0) ? -1 : 1;
+    int32_t const snap = min(max_accel, max_velocity) + (1L << STOP_FRAC);
+    int32_t out;
+
+    if ((labs(err) < snap) && (labs(err - velocity) < snap))
+    {
+        /*
+         * Arrived, the target and stopping there are both within a frame of
+         * acceleration, or of the velocity limit if lower, and the stopping
+         * test rounding.  Closer than that from still the stopping test
+         * would never let it start.  The last step is kept as the velocity,
+         * the next frame stops, or turns around from it.
+         */
+        position = target;
+        velocity = err;
+    }
+    else
+    {
+        if ((velocity ^ err) < 0)
+        {
+            /* moving away from the target, turn around */
+            velocity += dir * (int32_t) max_accel;
+
+            if ((uint32_t) labs(velocity) > max_velocity)
+            {
+                velocity = dir * (int32_t) max_velocity;
+            }
+        }
+        else if (speed > max_velocity)
+        {
+            /* the limit was lowered, slow down to it */
+            velocity -= dir * (int32_t) min(max_accel, speed - max_velocity);
+        }
+        else if ((speed < max_velocity) &&
+                 can_stop(speed + min(max_accel, max_velocity - speed), dist))
+        {
+            /* accelerate toward the target */
+            velocity += dir * (int32_t) min(max_accel, max_velocity - speed);
+        }
+        else if (!can_stop(speed, dist))
+        {
+            /* decelerate toward the target, but not through zero */
+            velocity -= dir * (int32_t) min(max_accel, speed);
+        }
+
+        /* past the target it turns around next frame, or arrives */
+        position += velocity;
+    }
+
+    /* S-curve filter */
+    history_sum += position - history[history_index];
+    history[history_index] = position;
+    history_index = (history_index + 1) & (ramp_frames - 1);
+
+    out = history_sum >> ramp_shift;
+
+    if ((position == target) && (0 == velocity) && (out == target))
+    {
+        moving = 0;
+    }
+
+    write_counts(out >> SERVO_FRAC);
+}
+
+
+/*
+ * Wake for the software edge at TCNT1 count at, SERVO_EDGE_LEAD counts early,
+ * or after EDGE_MAX_TICKS to look again if it is further off.  At least two
+ * ticks so TCNT2 cannot pass OCR2A while it is written.
+ */
+static void edge_alarm(uint16_t at)
+{
+    int16_t const wait = (int16_t) (at - TCNT1) - SERVO_EDGE_LEAD;
+    uint8_t ticks = EDGE_MAX_TICKS;
+
+    if (wait < (int16_t) (EDGE_MAX_TICKS * EDGE_TICK_COUNTS))
+    {
+        ticks = max(wait / (int16_t) EDGE_TICK_COUNTS, 2);
+    }
+
+    OCR2A = TCNT2 + ticks;
+}
+
+
+/*
+ * Timer 2 compare A, software channel falling edges.  Polls TCNT1 up to each
+ * edge that is due, then sets the alarm for the next.
+ */
+ISR(TIMER2_COMPA_vect)
+{
+    struct servo_edges const * const e = edges_front;
+    uint8_t i = edge_next;
+    uint16_t at = frame_start + e->at[i];
+
+    if ((int16_t) (at - TCNT1) > SERVO_EDGE_MERGE)
+    {
+        /*
+         * Woken early to look again.  Nearer than SERVO_EDGE_MERGE the two
+         * tick minimum alarm would wake past the edge, poll for it.
+         */
+        edge_alarm(at);
+        return;
+    }
+
+    for (;;)
+    {
+        while ((int16_t) (at - TCNT1) > 0)
+        {
+        }
+
+        pinmap_clear(e->fall[i]);
+
+        if (++i >= e->count)
+        {
+            /* last edge of the frame */
+            TIMSK2 &= ~_BV(OCIE2A);
+            break;
+        }
+
+        at = frame_start + e->at[i];
+
+        if ((int16_t) (at - TCNT1) > SERVO_EDGE_MERGE)
+        {
+            edge_alarm(at);
+            break;
+        }
+    }
+
+    edge_next = i;
+}
+
+
+/*
+ * Timer 1 overflow, TOP, start of a PWM frame.  Raise the software channels,
+ * set the alarm for their first fall, then step the OC1A motion.
+ */
+ISR(TIMER1_OVF_vect)
+{
+    struct servo_edges * e = edges_front;
+
+    if (edges_pending)
+    {
+        edges_front = edges_back;
+        edges_back = e;
+        edges_pending = 0;
+        e = edges_front;
+    }
+
+    pinmap_set(e->rise);
+    frame_start = TCNT1;
+
+    edge_next = 0;
+
+    if (e->count)
+    {
+        edge_alarm(frame_start + e->at[0]);
+        TIFR2 = _BV(OCF2A);
+        TIMSK2 |= _BV(OCIE2A);
+    }
+
+    if (moving)
+    {
+        servo_step();
+    }
+}
+
+
+void servo_set(uint16_t pulse_us)
+{
+    uint16_t const counts = counts_from_us(pulse_us);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        moving = 0;
+        position = target = (int32_t) counts << SERVO_FRAC;
+        velocity = 0;
+        history_fill(position);
+
+        write_counts(counts);
+    }
+}
+
+
+void servo_move(uint16_t pulse_us)
+{
+    uint16_t const counts = counts_from_us(pulse_us);
+
+    /* position is 32-bit and written by the frame interrupt */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ((0U == counts) || (0 == position))
+        {
+            /* off, or from off, there is no position to ramp from */
+            servo_set(pulse_us);
+        }
+        else if (target != ((int32_t) counts << SERVO_FRAC))
+        {
+            target = (int32_t) counts << SERVO_FRAC;
+            moving = 1;
+        }
+    }
+}
+
+
+/*
+ * Set the motion limits, velocity in us/s, accel in us/s^2 and jerk in
+ * us/s^3.  A jerk of 0 gives a trapezoidal profile, otherwise the
+ * acceleration ramp, 2 accel / jerk to cover a reversal, is rounded up to 1,
+ * 2, 4, 8 or 16 frames, a lower jerk gets 16.  The conversion to counts per
+ * frame is done here so the frame step has no division.
+ */
+void servo_limits(uint16_t velocity_us, uint32_t accel_us, uint32_t jerk_us)
+{
+    uint32_t v;
+    uint32_t a;
+    uint8_t shift = 0;
+
+    velocity_us = limit_range(1U, velocity_us, SERVO_MAX_VELOCITY);
+    accel_us = limit_range(1UL, accel_us, SERVO_MAX_ACCEL);
+
+    /* 2 counts per us */
+    v = UDIV_ROUND((uint32_t) velocity_us * (2UL << SERVO_FRAC), FRAME_HZ);
+    a = UDIV_ROUND(accel_us * (2UL << SERVO_FRAC), FRAME_HZ * FRAME_HZ);
+
+    if (0 == a)
+    {
+        a = 1;
+    }
+
+    if (jerk_us)
+    {
+        /* ramp frames, 2 accel / jerk s times the frame rate, rounded up */
+        uint32_t const frames = (2 * accel_us * FRAME_HZ - 1) / jerk_us + 1;
+
+        while ((shift < SERVO_RAMP_SHIFT_MAX) && ((1UL << shift) < frames))
+        {
+            shift++;
+        }
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        max_velocity = v;
+        max_accel = a;
+
+        if (shift != ramp_shift)
+        {
+            /* restart the filter from the current output */
+            position = history_sum >> ramp_shift;
+            ramp_shift = shift;
+            ramp_frames = 1 << shift;
+            history_fill(position);
+        }
+    }
+}
+
+
+/*
+ * Set a channel pulse width, from the start of the next frame.
+ */
+void servo_pulse(uint8_t channel, uint16_t pulse_us)
+{
+    struct servo_edges * e;
+    uint8_t i;
+
+    if (0 == channel)
+    {
+        servo_set(pulse_us);
+        return;
+    }
+
+    if (1 == channel)
+    {
+        /* OC1B, as OC1A without the motion profile */
+        uint16_t const counts = counts_from_us(pulse_us);
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            OCR1B = PWM_TOP - counts;
+        }
+        return;
+    }
+
+    if (channel >= SERVO_CHANNELS)
+    {
+        return;
+    }
+
+    soft_counts[channel - 2] = counts_from_us(pulse_us);
+
+    /*
+     * Take the back frame from the capture interrupt, then it is ours.  The
+     * atomic blocks are also memory barriers, edges_back is read after the
+     * take and the frame is written before it is handed back.
+     */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        edges_pending = 0;
+        e = edges_back;
+    }
+
+    e->rise = 0;
+    e->count = 0;
+
+    /* insertion sort on the falling edge time */
+    for (i = 0; i < ARRAY_SIZE(soft_counts); i++)
+    {
+        uint16_t const at = soft_counts[i];
+        uint8_t j = e->count;
+
+        if (0U == soft_counts[i])
+        {
+            continue;
+        }
+
+        e->rise |= soft_pins[i];
+
+        while (j && (e->at[j - 1] > at))
+        {
+            j--;
+        }
+
+        if (j && (e->at[j - 1] == at))
+        {
+            e->fall[j - 1] |= soft_pins[i];
+            continue;
+        }
+
+        memmove(&e->at[j + 1], &e->at[j], (e->count - j) * sizeof(e->at[0]));
+        memmove(&e->fall[j + 1], &e->fall[j],
+                (e->count - j) * sizeof(e->fall[0]));
+        e->at[j] = at;
+        e->fall[j] = soft_pins[i];
+        e->count++;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        edges_pending = 1;
+    }
+}
+
+
+uint16_t servo_position(void)
+{
+    int32_t p;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        p = history_sum >> ramp_shift;
+    }
+
+    return us_from_counts(p >> SERVO_FRAC);
+}
+
+
+uint8_t servo_busy(void)
+{
+    return moving;
+}
+
+
+void servo_init(void)
+{
+    uint8_t i;
+
+    /* initialize servo output pins */
+    pinmap_clear(SERVO_OUT | SERVO_OUT_B);
+    pinmap_dir(0, SERVO_OUT | SERVO_OUT_B);
+
+    for (i = 0; i < ARRAY_SIZE(soft_pins); i++)
+    {
+        pinmap_clear(soft_pins[i]);
+        pinmap_dir(0, soft_pins[i]);
+    }
+
+    // Timer 1, Fast PWM mode 14, WGM = 1:1:1:0, clk/8, both outputs off
+    TCCR1A = 0xF2;  // COM1A1:0 = 3, COM1B1:0 = 3, WGM11 = 1, WGM10 = 0
+    TCCR1B = 0x1A;  // WGM13 = 1, WGM12 = 1, CS = 2
+    TCCR1C = 0x00;
+    ICR1 = PWM_TOP;
+    OCR1A = PWM_TOP;
+    OCR1B = PWM_TOP;
+
+    /* frame start, timer 2 runs free and compare A is the edge alarm */
+    TIFR1 = _BV(TOV1);
+    TIMSK1 = _BV(TOIE1);
+
+    servo_limits(2000U, 10000UL, 0UL);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _SERVO_H_
+#define _SERVO_H_
+
+#include <stdint.h>
+
+/*
+ * Servo pulse width range in us, 0 turns the pulse off.
+ */
+#define SERVO_MIN_PULSE 500U
+#define SERVO_MAX_PULSE 2500U
+
+/*
+ * Motion limits, see servo_limits.
+ */
+#define SERVO_MAX_VELOCITY 20000U   /* us/s   */
+#define SERVO_MAX_ACCEL    100000UL /* us/s^2 */
+
+/*
+ * Servo outputs, SERVO_CHANNELS pulses sharing the 100 Hz timer 1 frame.
+ *
+ *  Channel 0 is OC1A.  servo_set jumps straight to a pulse width.  servo_move
+ *  ramps to it at the frame rate, limited by the velocity and acceleration
+ *  set with servo_limits, a trapezoidal velocity profile.  A non-zero jerk
+ *  limit also ramps the acceleration, an S-curve profile.  A move from off
+ *  jumps.  The frame step runs in the timer 1 overflow interrupt, at TOP.
+ *
+ *  Channel 1 is OC1B, set with servo_pulse.  Timer 1 runs in fast PWM with
+ *  TOP in ICR1, both compare outputs are made by the hardware and a new
+ *  width takes effect at the next frame.  OC1B is the SPI SS pin, as an
+ *  output it leaves SPI master mode alone.
+ *
+ *  Channels 2 and up are the SERVO_SOFT_PINS, set with servo_pulse.  They all
+ *  rise in the overflow interrupt and fall in order of pulse width, timed
+ *  from the TCNT1 read just after the rise.  The timer 2 compare A interrupt
+ *  wakes SERVO_EDGE_LEAD counts early for each fall and polls TCNT1 up to
+ *  it, edges less than SERVO_EDGE_MERGE counts apart are polled in the same
+ *  interrupt.  A new pulse width takes effect at the next frame, servo_pulse
+ *  builds the sorted edges in a second buffer that the frame start swaps in.
+ *
+ *  Jitter, in timer counts of 0.5 us (8 CPU cycles):
+ *
+ *   channels 0, 1  0, both edges are made by the compare hardware.
+ *
+ *   channels 2+    The alarm interrupt is taken 7 cycles after it is due,
+ *                  plus up to 4 finishing an instruction and 4 more from
+ *                  idle sleep, then the handler prologue, 4 to 6 counts in
+ *                  all.  It is due 8 to 12 counts before the edge, timer 2
+ *                  ticks are 4 counts, so it reaches the TCNT1 poll ahead of
+ *                  the edge.  The poll loop is about 1 count, so the fall
+ *                  lands 0 to 1 count late.  The rise sees the same entry
+ *                  latency but the width is timed from it, so it only moves
+ *                  the whole pulse.  Pulse width jitter is 1 count, until
+ *                  another handler is running when the alarm is due and
+ *                  runs past the 2 to 8 counts of slack, which delays the
+ *                  fall by the excess.  Each fall holds interrupts off for up
+ *                  to about 16 counts while it polls, an alarm any closer
+ *                  than that would wake past the edge.
+ */
+extern void servo_init(void);
+extern void servo_set(uint16_t pulse_us);
+extern void servo_move(uint16_t pulse_us);
+extern void servo_limits(uint16_t velocity_us, uint32_t accel_us,
+                         uint32_t jerk_us);
+extern void servo_pulse(uint8_t channel, uint16_t pulse_us);
+extern uint16_t servo_position(void);
+extern uint8_t servo_busy(void);
+
+#endif /* _SERVO_H_ */
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "project.h"
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+#include "librb.h"
+#include "timer.h"
+#include "console.h"
+#include "fmt.h"
+#include "shell.h"
+
+static struct shell_stats stats;
+
+/*
+ * Character access across the two spans of a line.
+ */
+static char line_at(struct console_line const * const line, uint8_t i)
+{
+    return (i < line->len[0]) ? line->ptr[0][i]
+                              : line->ptr[1][i - line->len[0]];
+}
+
+static uint8_t is_space(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\n');
+}
+
+
+static struct shell_command const * shell_lookup(char const * name)
+{
+    uint8_t lo = 0;
+    uint8_t hi = shell_commands_count;
+
+    while (lo < hi) {
+        uint8_t const mid = (lo + hi) / 2;
+        int const cmp = strncmp_P(name, shell_commands[mid].name,
+                                     SHELL_NAME_SIZE);
+
+        if (cmp == 0) return &shell_commands[mid];
+
+        if (cmp < 0) hi = mid;
+        else lo = mid + 1;
+    }
+
+    return NULL;
+}
+
+
+static void shell_execute(struct console_line const * const line, uint8_t len)
+{
+    char name[SHELL_NAME_SIZE + 1];
+    int32_t argv[SHELL_MAX_ARGS];
+    uint8_t argc = 0;
+    uint8_t n = 0;
+    uint8_t i = 0;
+    struct shell_command const * command;
+    int8_t (* handler)(uint8_t argc, int32_t const * argv);
+
+    /* command name */
+    while ((i < len) && is_space(line_at(line, i))) i++;
+
+    if (i == len) return;
+
+    while ((i < len) && !is_space(line_at(line, i))) {
+        if (n == SHELL_NAME_SIZE) goto error;
+        name[n++] = line_at(line, i++);
+    }
+
+    name[n] = '\0';
+
+    /* decimal arguments */
+    for (;;) {
+        uint8_t negative = 0;
+        uint32_t value = 0;
+        uint32_t limit = INT32_MAX;
+
+        while ((i < len) && is_space(line_at(line, i))) i++;
+
+        if (i == len) break;
+
+        if (argc == SHELL_MAX_ARGS) goto error;
+
+        if (line_at(line, i) == '-') {
+            negative = 1;
+            limit = (uint32_t) INT32_MAX + 1;
+            i++;
+        }
+
+        n = 0;
+
+        while ((i < len) && !is_space(line_at(line, i))) {
+            char const c = line_at(line, i++);
+
+            if ((c < '0') || (c > '9')) goto error;
+
+            /* reject values outside int32_t */
+            if (value > (limit - (c - '0')) / 10) goto error;
+
+            value = (value * 10) + (c - '0');
+            n++;
+        }
+
+        if (!n) goto error;
+
+        argv[argc++] = negative ? (int32_t) -value : (int32_t) value;
+    }
+
+    command = shell_lookup(name);
+
+    if (!command) goto error;
+
+    handler = pgm_read_ptr(&command->handler);
+
+    if (handler(argc, argv) >= 0) return;
+
+error:
+    fmt_line(FMT_S("?\n"));
+}
+
+
+/*
+ * Process one complete input line, if any.  Call from the main loop.
+ */
+void shell_poll(void)
+{
+    struct console_line line;
+    int16_t len;
+    tbtick_t latency;
+
+    len = console_readline(&line);
+
+    if (len < 0) return;
+
+    shell_execute(&line, len);
+
+    console_consume(len);
+
+    latency = tbtick_get() - line.tbtick;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        stats.last_latency = latency;
+        if (latency > stats.max_latency) stats.max_latency = latency;
+    }
+}
+
+
+void shell_get_stats(struct shell_stats * this_stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *this_stats = stats;
+    }
+}
+
+
+/*
+ * Input is polled from the main loop, so reads must not block.
+ */
+void shell_init(void)
+{
+    console_setattr(console_getattr() | INONBLOCK);
+
+    stats.last_latency = 0;
+    stats.max_latency = 0;
+}
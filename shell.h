@@ -0,0 +1,59 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _SHELL_H_
+#define _SHELL_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+/*
+ * Console command shell.
+ *
+ *  Lines are read in place with console_readline.  The first word selects a
+ *  command by binary search of a table in program memory, the remaining words
+ *  are parsed as decimal integers and passed to the handler.  The table is
+ *  supplied by the application and must be sorted by name.
+ */
+#define SHELL_NAME_SIZE (8)
+#define SHELL_MAX_ARGS  (4)
+
+struct shell_command {
+    char name[SHELL_NAME_SIZE];
+    int8_t (* handler)(uint8_t argc, int32_t const * argv);
+};
+
+#define SHELL_COMMAND(name,handler) { name, handler }
+
+/*
+ * command table, sorted by name, defined by the application
+ */
+extern const struct shell_command shell_commands[] PROGMEM;
+extern const uint8_t shell_commands_count;
+
+/*
+ * command latency, newline received to handler complete, in timebase ticks
+ */
+struct shell_stats {
+    uint32_t last_latency;
+    uint32_t max_latency;
+};
+
+extern void shell_init(void);
+extern void shell_poll(void);
+extern void shell_get_stats(struct shell_stats * this_stats);
+
+#endif /* _SHELL_H_ */
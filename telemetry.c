@@ -0,0 +1,100 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#if defined(__AVR__)
+#include "project.h"
+
+#include <stdio.h>
+#include <util/crc16.h>
+#else
+#include <stdint.h>
+
+#define UDIV_CEILING(a,b) (((a) + (b) - 1) / (b))
+
+/*
+ * util/crc16.h equivalent, so the encoder can be tested on a host.
+ */
+static uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+    crc ^= (uint16_t) data << 8;
+
+    for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+
+    return crc;
+}
+#endif /* __AVR__ */
+
+#include "console.h"
+#include "telemetry.h"
+
+/*
+ * Body is type, record and CRC, COBS adds one byte per 254 plus one.
+ */
+#define BODY_SIZE  (1 + TELEMETRY_MAX_RECORD + 2)
+#define FRAME_SIZE (2 + BODY_SIZE + UDIV_CEILING(BODY_SIZE, 254))
+
+static uint8_t frame[FRAME_SIZE];
+
+/*
+ * COBS encoder state.
+ */
+static uint8_t code_idx;
+static uint8_t out_idx;
+
+static void cobs_put(uint8_t b)
+{
+    if (b) {
+        frame[out_idx++] = b;
+    }
+
+    if (!b || ((out_idx - code_idx) == 0xFF)) {
+        frame[code_idx] = out_idx - code_idx;
+        code_idx = out_idx++;
+    }
+}
+
+
+int8_t telemetry_send(uint8_t type, void const * record, uint8_t len)
+{
+    uint8_t const * p = record;
+    uint16_t crc;
+
+    if ((len > TELEMETRY_MAX_RECORD) || console_frame_busy()) return -1;
+
+    /* leading delimiter and first code byte */
+    frame[0] = 0x00;
+    code_idx = 1;
+    out_idx = 2;
+
+    crc = _crc_xmodem_update(0, type);
+    cobs_put(type);
+
+    while (len--) {
+        crc = _crc_xmodem_update(crc, *p);
+        cobs_put(*p++);
+    }
+
+    cobs_put(crc >> 8);
+    cobs_put(crc);
+
+    /* final code byte and trailing delimiter */
+    frame[code_idx] = out_idx - code_idx;
+    frame[out_idx++] = 0x00;
+
+    return console_frame(frame, out_idx);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+
+/*
+ * Binary telemetry frames, interleaved with console text at line boundaries.
+ *
+ *  0x00 | COBS(type, record[0..n-1], crc_hi, crc_lo) | 0x00
+ *
+ *  The CRC is CRC-16/XMODEM (poly 0x1021, init 0) over type and record.  COBS
+ *  removes every 0x00 from the encoded body, and text never contains 0x00, so
+ *  a receiver separates frames from text by the delimiters alone.  host/
+ *  tmdecode.c is a matching decoder.
+ *
+ *  An n byte record costs n + 6 bytes on the wire (n < 254), 11 bit times
+ *  each at 8N2.  For a 16 byte record that is the line rate limit of:
+ *
+ *       9600 baud     39 records/s
+ *      57600 baud    238 records/s
+ *     115200 baud    476 records/s
+ *    1000000 baud   4132 records/s
+ */
+#ifndef TELEMETRY_MAX_RECORD
+#define TELEMETRY_MAX_RECORD (32)
+#endif
+
+/*
+ * Queue a record for transmission.  Non-blocking, returns -1 if the previous
+ * frame has not been sent yet or the record is too long.
+ */
+extern int8_t telemetry_send(uint8_t type, void const * record, uint8_t len);
+
+#endif /* _TELEMETRY_H_ */
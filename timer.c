@@ -29,6 +29,11 @@
 static tbtick_t tbtick_counter;
 static struct timer_event * timer_event_list;
 
+/*
+ * timer event statistics
+ */
+static struct timer_stats stats;
+
 #if (TBTIMER == 0)
 tbtick_t tbtick_update(void) __attribute__((__naked__));
 tbtick_t tbtick_update(void)
@@ -197,6 +202,9 @@ static void tbtimer_handler(void)
                 /* handle expired timer event */
                 struct timer_event * this_timer_event;
 
+                stats.events++;
+                if (-delta > stats.max_late) stats.max_late = -delta;
+
                 this_timer_event = timer_event_list;
                 timer_event_list = this_timer_event->next;
                 this_timer_event->next = this_timer_event;
@@ -284,6 +292,25 @@ void cancel_timer_event(struct timer_event * this_timer_event)
 }
 
 
+void timer_get_stats(struct timer_stats * this_stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *this_stats = stats;
+    }
+}
+
+
+void timer_clear_stats(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        stats.events = 0;
+        stats.max_late = 0;
+    }
+}
+
+
 void timer_delay(tbtick_st ticks)
 {
     struct timer_event timer_delay_event;
@@ -313,6 +340,8 @@ void tbtick_init(void)
      */
     tbtick_counter = 0;
     timer_event_list = NULL;
+    stats.events = 0;
+    stats.max_late = 0;
 
     /* clear pending timer interrupts */
     TBTIFR = _BV(TBTOCF);
@@ -95,6 +95,15 @@ struct timer_event {
     int8_t (* handler)(struct timer_event * this_timer_event);
 };
 
+/*
+ * timer event statistics, max_late is the largest number of ticks an event was
+ * handled after its scheduled tick
+ */
+struct timer_stats {
+    uint32_t events;
+    tbtick_st max_late;
+};
+
 #define TIMER_EVENT_INIT(name,handler) { &name, 0, handler }
 #define TIMER_EVENT(name,handler)                                              \
         static int8_t handler(struct timer_event * this_timer_event);          \
@@ -179,5 +188,7 @@ extern void tbtick_init(void);
 extern void schedule_timer_event(struct timer_event * this_timer_event, struct timer_event * ref_timer_event);
 extern void cancel_timer_event(struct timer_event * this_timer_event);
 extern void timer_delay(tbtick_st ticks);
+extern void timer_get_stats(struct timer_stats * this_stats);
+extern void timer_clear_stats(void);
 
 #endif /* _TIMER_H_ */
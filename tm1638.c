@@ -27,6 +27,7 @@
 #include "timer.h"
 #include "pinmap.h"
 #include "tm1638.h"
+#include "bibase.h"
 
 
 #define TM1638_DELAY_US          (1)
@@ -81,6 +82,10 @@ static uint8_t active_command = TM1638_IDLE;
 static uint8_t state;
 static uint8_t * data;
 
+/* keys at the last TM1638_EV_KEYS, and when they were scanned */
+static uint32_t keys_seen;
+static tbtick_t keys_tbtick;
+
 
 static void TM1638_command_dispatch(void)
 {
@@ -154,6 +159,15 @@ ISR(SPI_STC_vect)
             *data++ = SPDR;
             pinmap_dir(0, PINMAP_MOSI);
 
+            keys_tbtick = tbtick_update();
+
+            /* tell the main loop if the keys changed or are held */
+            if ((keys_buffer != keys_seen) || keys_buffer)
+            {
+                keys_seen = keys_buffer;
+                GPIOR0 |= TM1638_EV_KEYS;
+            }
+
             GPIOR0 &= ~TM1638_EV_BUSY;
         }
         break;
@@ -229,6 +243,18 @@ uint32_t TM1638_get_keys(void)
     return keys_buffer;
 }
 
+uint32_t TM1638_keys_tbtick(void)
+{
+    tbtick_t tbtick;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tbtick = keys_tbtick;
+    }
+
+    return tbtick;
+}
+
 void TM1638_enable(uint8_t const enable)
 {
     _config = (_config & ~TM1638_DISPLAY_ON)
@@ -253,6 +279,12 @@ tbtick_t keys_update_interval;
 
 static int8_t keys_update_handler(struct timer_event * this_timer_event)
 {
+    /* scanning is off, do not reschedule */
+    if (0 == keys_update_interval)
+    {
+        return 0;
+    }
+
     /* set pending command bit */
     pending_command |= TM1638_READ_KEYS;
 
@@ -271,6 +303,30 @@ static struct timer_event keys_update_event = {
 };
 
 
+void TM1638_keys_interval(uint8_t const keys_update_ms)
+{
+    /*
+     * Cancel before the interval goes to 0, the handler must not run with a
+     * zero interval or it would be rescheduled at the same tick forever.
+     */
+    if (0 == keys_update_ms)
+    {
+        cancel_timer_event(&keys_update_event);
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        keys_update_interval = TBTICKS_FROM_MS(keys_update_ms);
+    }
+
+    if ((0 != keys_update_ms) && timer_is_expired(&keys_update_event))
+    {
+        keys_update_event.tbtick = keys_update_interval;
+        schedule_timer_event(&keys_update_event, NULL);
+    }
+}
+
+
 void TM1638_init(uint8_t const keys_update_ms)
 {
     /* initialize SPI interface */
@@ -311,6 +367,14 @@ void TM1638_init(uint8_t const keys_update_ms)
 }
 
 
+/*
+ * glyphs for sign, overflow and decimal point
+ */
+#define TM1638_GLYPH_BLANK      0x00
+#define TM1638_GLYPH_MINUS      0x40
+#define TM1638_GLYPH_DP         0x80
+
+
 /*
  * Display segments
  *
@@ -400,3 +464,94 @@ void TM1638_write_digit(uint8_t const digit, int8_t const value)
     }
 }
 
+
+/*
+ * Transpose count glyphs into the segment buffer starting at digit position.
+ * The glyphs array is consumed.
+ */
+static void TM1638_write_glyphs(uint8_t const position, uint8_t const count,
+                                uint8_t * const glyphs)
+{
+    uint16_t const digit_mask = ((0x0001 << count) - 1) << position;
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(segments_buffer); i += 2)
+    {
+        uint16_t * segment_word = (uint16_t *) &segments_buffer[i];
+        uint16_t segment_bits = 0;
+
+        for (uint8_t d = count; d-- > 0; )
+        {
+            segment_bits = (segment_bits << 1) | (glyphs[d] & 0x01);
+            glyphs[d] >>= 1;
+        }
+
+        *segment_word = (*segment_word & ~digit_mask)
+                      | (segment_bits << position);
+    }
+
+    /* schedule segment update */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pending_command |= TM1638_WRITE_SEGMENTS;
+    }
+}
+
+void TM1638_write_number(uint8_t const position, uint8_t width,
+                         int32_t const value, uint8_t scale)
+{
+    uint8_t glyphs[TM1638_MAX_DIGIT + 1];
+    uint32_t const magnitude = (value < 0) ? -(uint32_t) value
+                                           : (uint32_t) value;
+    uint8_t n_digit;
+
+    if ((position > TM1638_MAX_DIGIT) || (0 == width))
+    {
+        return;
+    }
+
+    width = min(width, (uint8_t) (TM1638_MAX_DIGIT + 1 - position));
+    scale = min(scale, (uint8_t) (width - 1));
+
+    /* convert to digits, least significant first */
+    n_digit = bibase32(magnitude, glyphs, 246);
+
+    /* leading zeros up to and including the units digit */
+    while (n_digit <= scale)
+    {
+        glyphs[n_digit++] = 0;
+    }
+
+    if ((n_digit + (value < 0)) > width)
+    {
+        /* overflow, dash every position */
+        for (uint8_t i = 0; i < width; i++)
+        {
+            glyphs[i] = TM1638_GLYPH_MINUS;
+        }
+    }
+    else
+    {
+        for (uint8_t i = 0; i < n_digit; i++)
+        {
+            glyphs[i] = pgm_read_byte(&_digit_segments[glyphs[i]]);
+        }
+
+        if (scale)
+        {
+            glyphs[scale] |= TM1638_GLYPH_DP;
+        }
+
+        if (value < 0)
+        {
+            glyphs[n_digit++] = TM1638_GLYPH_MINUS;
+        }
+
+        /* leading zero suppression */
+        while (n_digit < width)
+        {
+            glyphs[n_digit++] = TM1638_GLYPH_BLANK;
+        }
+    }
+
+    TM1638_write_glyphs(position, width, glyphs);
+}
@@ -53,10 +53,29 @@ extern void TM1638_write_segments(void);
 extern void TM1638_read_keys(void);
 extern uint32_t TM1638_get_keys(void);
 
+/*
+ * Time of the last key scan, in timebase ticks
+ */
+extern uint32_t TM1638_keys_tbtick(void);
+
+/*
+ * Set key scan interval, 0 stops scanning
+ */
+extern void TM1638_keys_interval(uint8_t const keys_update_ms);
+
 /*
  * Display digit ('0'..'F')
  */
 extern void TM1638_write_digit(uint8_t const position, int8_t const value);
 
+/*
+ * Display a signed fixed-point value, scale digits after the decimal point,
+ * right aligned in width digits starting at position.  Leading zeros are
+ * blanked and a value that does not fit is shown as dashes.  A zero width or
+ * a position past the last digit writes nothing.
+ */
+extern void TM1638_write_number(uint8_t const position, uint8_t width,
+                                int32_t const value, uint8_t scale);
+
 #endif /* !_TM1638_H_ */
 
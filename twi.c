@@ -0,0 +1,279 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "project.h"
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <util/twi.h>
+
+#include "twi.h"
+
+
+/* TWCR to continue, clear TWINT with the interrupt enabled */
+#define TWCR_GO     (_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
+
+/* bit rate, prescaler 1 */
+#define TWI_TWBR    (((F_CPU / TWI_FREQ) - 16) / 2)
+
+/*
+ * transaction queue, head is on the bus while active
+ */
+static struct twi_xfer * head;
+static struct twi_xfer * tail;
+static volatile uint8_t active;
+
+/* head transaction progress, read phase and bytes so far in this phase */
+static uint8_t reading;
+static uint8_t count;
+static uint8_t retries;
+
+static struct twi_stats stats;
+
+
+/*
+ * START, or if a STOP is still going out STOP then START, which the TWI
+ * issues in order without waiting on TWSTO here.
+ */
+static void twi_start(void)
+{
+    reading = 0;
+    TWCR = TWCR_GO | _BV(TWSTA) | (TWCR & _BV(TWSTO));
+}
+
+
+/*
+ * Finish the head transaction and move on, a repeated START into a chained
+ * transaction, STOP and START for the next, or STOP and release the bus.
+ */
+static void twi_complete(int8_t status)
+{
+    struct twi_xfer * this_xfer = head;
+    uint8_t chain = this_xfer->flags & TWI_CHAIN;
+    uint8_t twcr;
+
+    stats.xfers++;
+
+    /* after a lost arbitration the bus is not ours to STOP */
+    twcr = (status == TWI_ARB_LOST) ? 0 : _BV(TWSTO);
+
+    for (;;)
+    {
+        head = this_xfer->next;
+        if (head == NULL) tail = NULL;
+
+        this_xfer->status = status;
+        if (this_xfer->done) this_xfer->done(this_xfer);
+
+        /* a failed transaction takes the rest of its chain with it */
+        if ((status == TWI_OK) || !chain || (head == NULL)) break;
+
+        this_xfer = head;
+        chain = this_xfer->flags & TWI_CHAIN;
+        status = TWI_ABORTED;
+    }
+
+    reading = 0;
+    retries = 0;
+
+    if (head == NULL)
+    {
+        active = 0;
+        TWCR = _BV(TWINT) | _BV(TWEN) | twcr;
+    }
+    else if (chain && (status == TWI_OK))
+    {
+        TWCR = TWCR_GO | _BV(TWSTA);
+    }
+    else
+    {
+        TWCR = TWCR_GO | _BV(TWSTA) | twcr;
+    }
+}
+
+
+ISR(TWI_vect)
+{
+    struct twi_xfer * const this_xfer = head;
+
+    switch (TW_STATUS)
+    {
+    case TW_START:
+    case TW_REP_START:
+        count = 0;
+        if (!this_xfer->wlen && this_xfer->rlen) reading = 1;
+        TWDR = (this_xfer->address << 1) | (reading ? TW_READ : TW_WRITE);
+        TWCR = TWCR_GO;
+        break;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+        if (count < this_xfer->wlen)
+        {
+            TWDR = this_xfer->wbuf[count++];
+            TWCR = TWCR_GO;
+        }
+        else if (this_xfer->rlen)
+        {
+            /* repeated START to read */
+            reading = 1;
+            TWCR = TWCR_GO | _BV(TWSTA);
+        }
+        else
+        {
+            twi_complete(TWI_OK);
+        }
+        break;
+
+    case TW_MT_SLA_NACK:
+    case TW_MT_DATA_NACK:
+    case TW_MR_SLA_NACK:
+        stats.nacks++;
+        twi_complete(TWI_NACK);
+        break;
+
+    case TW_MT_ARB_LOST:
+        /* another master won, start over when the bus is free */
+        stats.arb_lost++;
+        if (++retries <= TWI_RETRIES)
+        {
+            reading = 0;
+            TWCR = TWCR_GO | _BV(TWSTA);
+        }
+        else
+        {
+            twi_complete(TWI_ARB_LOST);
+        }
+        break;
+
+    case TW_MR_SLA_ACK:
+        /* ACK all but the last byte */
+        TWCR = TWCR_GO | ((this_xfer->rlen > 1) ? _BV(TWEA) : 0);
+        break;
+
+    case TW_MR_DATA_ACK:
+        this_xfer->rbuf[count++] = TWDR;
+        TWCR = TWCR_GO | ((count + 1 < this_xfer->rlen) ? _BV(TWEA) : 0);
+        break;
+
+    case TW_MR_DATA_NACK:
+        this_xfer->rbuf[count++] = TWDR;
+        twi_complete(TWI_OK);
+        break;
+
+    default:
+        /* bus error, TWSTO recovers the bus without sending a STOP */
+        stats.bus_errors++;
+        twi_complete(TWI_BUS_ERROR);
+        break;
+    }
+}
+
+
+int8_t twi_submit(struct twi_xfer * this_xfer)
+{
+    int8_t rc = -1;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (this_xfer->status != TWI_PENDING)
+        {
+            this_xfer->status = TWI_PENDING;
+            this_xfer->next = NULL;
+
+            if (tail) tail->next = this_xfer;
+            else head = this_xfer;
+            tail = this_xfer;
+
+            if (!active)
+            {
+                active = 1;
+                retries = 0;
+                twi_start();
+            }
+
+            rc = 0;
+        }
+    }
+
+    return rc;
+}
+
+
+/*
+ * wait, sleep until the transaction completes, returns its status
+ */
+int8_t twi_wait(struct twi_xfer const * this_xfer)
+{
+    for (;;)
+    {
+        cli();
+
+        if (this_xfer->status != TWI_PENDING) break;
+
+        /* Wait for an interrupt before trying again. */
+        SMCR = SLEEP_MODE_IDLE | _BV(SE);
+        sei();
+        sleep_cpu();
+        SMCR = SLEEP_MODE_IDLE;
+    }
+
+    sei();
+
+    return this_xfer->status;
+}
+
+
+uint8_t twi_busy(void)
+{
+    return active;
+}
+
+
+void twi_get_stats(struct twi_stats * this_stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *this_stats = stats;
+    }
+}
+
+
+void twi_clear_stats(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+}
+
+
+void twi_init(void)
+{
+    /* internal pull-ups on SDA and SCL */
+    pinmap_set(PINMAP_SDA | PINMAP_SCL);
+
+    head = NULL;
+    tail = NULL;
+    active = 0;
+
+    TWSR = 0x00;
+    TWBR = TWI_TWBR;
+    TWCR = _BV(TWEN);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2013-2023 Chris Rhodin <chris@notav8.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _TWI_H_
+#define _TWI_H_
+
+#include <stdint.h>
+
+/*
+ * transaction status
+ */
+#define TWI_OK          (0)
+#define TWI_PENDING     (1)
+#define TWI_NACK        (-1)    /* address or data not acknowledged */
+#define TWI_ARB_LOST    (-2)    /* arbitration lost TWI_RETRIES times */
+#define TWI_BUS_ERROR   (-3)    /* illegal START or STOP on the bus */
+#define TWI_ABORTED     (-4)    /* chained to a transaction that failed */
+
+/* restarts after a lost arbitration before giving up */
+#define TWI_RETRIES     (3)
+
+/*
+ * transaction flags
+ */
+#define TWI_CHAIN       _BV(0)  /* repeated START into the next transaction */
+
+/*
+ * TWI master transaction
+ *
+ *  Writes wlen bytes from wbuf then, after a repeated START, reads rlen bytes
+ *  into rbuf, either may be 0.  address is the 7-bit slave address.  A
+ *  transaction flagged TWI_CHAIN keeps the bus and starts the next queued
+ *  transaction with a repeated START instead of a STOP.  done, if not NULL,
+ *  is called from the TWI interrupt when the transaction completes.
+ *
+ *  The descriptor and buffers belong to the driver from twi_submit until
+ *  status is no longer TWI_PENDING.
+ */
+struct twi_xfer {
+    struct twi_xfer * next;
+    uint8_t address;
+    uint8_t flags;
+    uint8_t wlen;
+    uint8_t rlen;
+    uint8_t const * wbuf;
+    uint8_t * rbuf;
+    void (* done)(struct twi_xfer * this_xfer);
+    volatile int8_t status;
+};
+
+/*
+ * TWI statistics
+ */
+struct twi_stats {
+    uint32_t xfers;
+    uint16_t nacks;
+    uint16_t arb_lost;
+    uint16_t bus_errors;
+};
+
+/*
+ * Interrupt driven TWI master.
+ *
+ *  twi_submit queues a transaction and returns at once, transactions run in
+ *  order from the TWI interrupt, one interrupt per bus event.  STOP and a
+ *  following START are issued together, nothing waits on the bus.  Returns
+ *  -1 if the transaction is already queued.  twi_wait sleeps until a
+ *  transaction completes and returns its status.
+ */
+extern void twi_init(void);
+extern int8_t twi_submit(struct twi_xfer * this_xfer);
+extern int8_t twi_wait(struct twi_xfer const * this_xfer);
+extern uint8_t twi_busy(void);
+extern void twi_get_stats(struct twi_stats * this_stats);
+extern void twi_clear_stats(void);
+
+#endif /* _TWI_H_ */